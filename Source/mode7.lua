@@ -30,6 +30,13 @@ end
 
 -- World
 
+mode7.world.kAddressModeFill = 0
+mode7.world.kAddressModeRepeat = 1
+mode7.world.kAddressModeMirroredRepeat = 2
+
+mode7.world.kGridTypeDense = 0
+mode7.world.kGridTypeSparse = 1
+
 --- Returns a new default configuration for the world.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-defaultConfiguration
@@ -39,7 +46,9 @@ mode7.world.defaultConfiguration = function()
         width = 1024,
         height = 1024,
         depth = 1024,
-        gridCellSize = 256
+        gridCellSize = 256,
+        gridType = mode7.world.kGridTypeDense,
+        grid2D = false
     }
 end
 
@@ -51,7 +60,8 @@ end
 mode7.world.new = function(configuration)
     return mode7.world._new(
         configuration.width, configuration.height, configuration.depth,
-        configuration.gridCellSize
+        configuration.gridCellSize, configuration.gridType,
+        configuration.grid2D
     )
 end
 
@@ -133,6 +143,10 @@ mode7.display.kFlipModeX = 1
 mode7.display.kFlipModeY = 2
 mode7.display.kFlipModeXY = 3
 
+mode7.display.kRenderModeFull = 0
+mode7.display.kRenderModeInterlaced = 1
+mode7.display.kRenderModeCheckerboard = 2
+
 -- Sprite
 
 mode7.sprite.datasource.kFrame = 0
@@ -152,6 +166,9 @@ mode7.sprite.kVisibilityModeShader = 1
 
 -- Bitmap
 
+mode7.bitmap.kLayoutLinear = 0
+mode7.bitmap.kLayoutTiled = 1
+
 --- Creates a new bitmap filled with bgColor.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmap-new
@@ -8,6 +8,8 @@ mode7.world = {}
 ---@field height integer
 ---@field depth integer
 ---@field gridCellSize integer
+---@field gridType integer
+---@field grid2D boolean
 mode7.world.configuration = {}
 
 ---@class mode7.display
@@ -80,8 +82,10 @@ mode7.color = {}
 ---@param height integer
 ---@param depth integer
 ---@param gridCellSize integer
+---@param gridType integer
+---@param grid2D boolean
 ---@return mode7.world
-function mode7.world._new(width, height, depth, gridCellSize) return mode7.world end
+function mode7.world._new(width, height, depth, gridCellSize, gridType, grid2D) return mode7.world end
 
 ---@param gray integer
 ---@param alpha integer
@@ -211,6 +215,30 @@ function mode7.world:setCeilingTilemap(tilemap) end
 ---@return mode7.tilemap
 function mode7.world:getCeilingTilemap() return {} end
 
+--- Sets the address mode for the plane bitmap, it controls how the out-of-bounds space is drawn. Default value is kAddressModeFill.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-setPlaneAddressMode
+---@param addressMode integer
+function mode7.world:setPlaneAddressMode(addressMode) end
+
+--- Gets the address mode for the plane bitmap.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-getPlaneAddressMode
+---@return integer
+function mode7.world:getPlaneAddressMode() return 0 end
+
+--- Sets the address mode for the ceiling bitmap, it controls how the out-of-bounds space is drawn. Default value is kAddressModeFill.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-setCeilingAddressMode
+---@param addressMode integer
+function mode7.world:setCeilingAddressMode(addressMode) end
+
+--- Gets the address mode for the ceiling bitmap.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-getCeilingAddressMode
+---@return integer
+function mode7.world:getCeilingAddressMode() return 0 end
+
 --- Converts a world point to a display point. The z component of the returned value is 1 if the point is in front of the camera or -1 if the point is behind the camera.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-worldToDisplayPoint
@@ -289,6 +317,19 @@ function mode7.world:update() end
 ---@param display mode7.display?
 function mode7.world:draw(display) end
 
+--- Draws the contents of the world for all the displays.
+--- Displays with the same camera and the same settings are drawn once and copied.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-drawAll
+function mode7.world:drawAll() end
+
+--- Gets the number of grid cells and sprite references visited by the grid queries in the last update.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-getQueryStats
+---@return integer cells
+---@return integer sprites
+function mode7.world:getQueryStats() return 0, 0 end
+
 --- Returns a mode7.array (not a Lua array) of all sprites added to the world.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-world-getSprites
@@ -334,6 +375,7 @@ function mode7.display:getRect() return 0, 0, 0, 0 end
 --- You should set the display rect relative to the orientation. E.g. for a portrait display, the rect is x = 0, y = 0, width = 240, height = 400.
 --- Functions such as world:worldToDisplayPoint return display coordinates relative to the orientation as well.
 --- You can use display:convertPointFromOrientation to convert a point from the orientation coordinate system.
+--- Frames with a visible sprite that has a custom draw function are drawn offscreen and rotated when displayed, which is slower.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-setOrientation
 ---@param orientation integer
@@ -385,6 +427,20 @@ function mode7.display:setScale(scale) end
 ---@return integer
 function mode7.display:getScale() return 0 end
 
+--- Sets the distances beyond which plane rows are sampled every 2 or 4 pixels, regardless of the display scale. Pass 0 to disable a band.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-setAdaptiveScale
+---@param distance2x number
+---@param distance4x number
+function mode7.display:setAdaptiveScale(distance2x, distance4x) end
+
+--- Gets the adaptive scale distances.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-getAdaptiveScale
+---@return number distance2x
+---@return number distance4x
+function mode7.display:getAdaptiveScale() return 0, 0 end
+
 --- Sets the dither type for the plane.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-setDitherType
@@ -397,6 +453,55 @@ function mode7.display:setDitherType(type) end
 ---@return integer
 function mode7.display:getDitherType() return 0 end
 
+--- Sets the render mode for the plane. Interlaced and checkerboard modes redraw half of the plane each frame and keep the other half, the framebuffer must not be cleared between frames.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-setRenderMode
+---@param mode integer
+function mode7.display:setRenderMode(mode) end
+
+--- Gets the render mode for the plane.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-getRenderMode
+---@return integer
+function mode7.display:getRenderMode() return 0 end
+
+--- Sets the camera movement (distance and angle in radians) between frames beyond which the plane is fully redrawn.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-setRefreshThreshold
+---@param distance number
+---@param angle number
+function mode7.display:setRefreshThreshold(distance, angle) end
+
+--- Gets the refresh threshold.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-getRefreshThreshold
+---@return number distance
+---@return number angle
+function mode7.display:getRefreshThreshold() return 0, 0 end
+
+--- Enables row diffing. The display keeps a copy of its last frame and marks for update only the rows that changed, content drawn over the display by other code should be redrawn every frame.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-setRowDiffing
+---@param flag boolean
+function mode7.display:setRowDiffing(flag) end
+
+--- Returns true if row diffing is enabled.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-getRowDiffing
+---@return boolean
+function mode7.display:getRowDiffing() return false end
+
+--- Returns the number of rows that were not marked for update in the last frame, if row diffing is enabled.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-getSkippedRows
+---@return integer
+function mode7.display:getSkippedRows() return 0 end
+
+--- Forces a full redraw of the plane in the next frame. If nothing changes, the display reuses the plane rows of the last frame and draws only the background and sprites, rows above the plane are left to other code; call this after modifying the background image.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-invalidate
+function mode7.display:invalidate() end
+
 --- Returns the background interface associated to the display.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-display-getBackground
@@ -576,6 +681,33 @@ function mode7.bitmap:getLayers() return {} end
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmap-removeAllLayers
 function mode7.bitmap:removeAllLayers() end
 
+--- Generates the mipmaps for the bitmap. Planes and tiles far from the camera are sampled from a smaller level, which reduces aliasing. Call it right after loadPGM to keep the levels in the pool, next to the bitmap data. Layers update the mipmaps when drawn.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmap-generateMipmaps
+function mode7.bitmap:generateMipmaps() end
+
+--- Removes the mipmaps from the bitmap.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmap-removeMipmaps
+function mode7.bitmap:removeMipmaps() end
+
+--- Sets the storage layout of the bitmap. A tiled bitmap is stored in 8x8 blocks, it's faster to draw when the camera looks along the bitmap columns. If the size is a multiple of 8, the bitmap is converted in place. Default value is kLayoutLinear.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmap-setLayout
+---@param layout integer
+function mode7.bitmap:setLayout(layout) end
+
+--- Gets the storage layout of the bitmap.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmap-getLayout
+---@return integer
+function mode7.bitmap:getLayout() return 0 end
+
+--- Notifies that the bitmap data was modified directly. Mipmaps are updated and displays redraw the plane.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmap-invalidate
+function mode7.bitmap:invalidate() end
+
 --- Creates a new layer with the given bitmap.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-bitmapLayer-newLayer
@@ -856,6 +988,18 @@ function mode7.camera:setClipDistanceUnits(units) end
 ---@return number
 function mode7.camera:getClipDistanceUnits() return 0 end
 
+--- Sets the camera far distance. Plane and ceiling rows beyond it are drawn with the fill color (shaded, if a shader is set) without sampling the bitmap, sprites beyond it are hidden. A value of 0 means no limit, it's the default value.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-camera-setFarDistance
+---@param distance number
+function mode7.camera:setFarDistance(distance) end
+
+--- Gets the camera far distance.
+---
+--- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-camera-getFarDistance
+---@return number
+function mode7.camera:getFarDistance() return 0 end
+
 --- Adjusts the camera orientation (angle, pitch) to look at the given point.
 ---
 --- https://risolvipro.github.io/playdate-mode7/Lua-API.html#def-camera-lookAtPoint
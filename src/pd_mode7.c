@@ -15,6 +15,18 @@
 #define MODE7_MAX_DISPLAYS 4
 #define MODE7_SPRITE_DSOURCE_LEN 4
 #define MODE7_INFINITY_E 0.5f
+#define MODE7_MIP_MAX_LEVELS 8
+#define MODE7_BITMAP_BLOCK_LOG 3
+
+#if PD_MODE7_FIXED_POINT
+// Plane points are stepped as signed 18.14 fixed-point values.
+// The integer part covers ±131072 texels, enough for worlds up to 65536 units plus the out-of-bounds margin.
+// Each step is rounded to 2^-14, so a 400-pixel scanline drifts by less than 400 * 2^-15 ≈ 0.013 texels.
+// Rows with endpoints outside that range (close to the horizon) fall back to float stepping.
+#define MODE7_FIXED_SHIFT 14
+#define MODE7_FIXED_ONE (1 << MODE7_FIXED_SHIFT)
+#define MODE7_FIXED_LIMIT 131071.0f
+#endif
 
 PDMode7_API *mode7;
 static PlaydateAPI *playdate;
@@ -22,6 +34,7 @@ static PlaydateAPI *playdate;
 typedef struct {
     char *ptr;
     char *originalPtr;
+    size_t size;
 } _PDMode7_Pool;
 
 typedef struct {
@@ -31,6 +44,7 @@ typedef struct {
 typedef struct {
     void **items;
     int length;
+    int capacity;
 } _PDMode7_Array;
 
 typedef enum {
@@ -107,8 +121,18 @@ typedef struct PDMode7_SpriteInstance {
     _PDMode7_LuaBitmapTable *luaBitmapTable;
     _PDMode7_Callback *drawCallback;
     void *userdata;
+    int bitmapTableWidth;
 } PDMode7_SpriteInstance;
 
+typedef struct {
+    int startX;
+    int endX;
+    int startY;
+    int endY;
+    int startZ;
+    int endZ;
+} _PDMode7_GridRange;
+
 typedef struct PDMode7_Sprite {
     PDMode7_World *world;
     PDMode7_Vec3 size;
@@ -117,23 +141,46 @@ typedef struct PDMode7_Sprite {
     float pitch;
     PDMode7_SpriteInstance *instances[MODE7_MAX_DISPLAYS];
     _PDMode7_Array *gridCells;
+    _PDMode7_GridRange gridRange;
+    unsigned int gridQuery;
     LuaUDObject *luaRef;
     _PDMode7_LuaSpriteDataSource *luaDataSource;
 } PDMode7_Sprite;
 
 typedef struct {
     _PDMode7_Array *sprites;
+    int index;
 } _PDMode7_GridCell;
 
 typedef struct _PDMode7_Grid {
+    PDMode7_GridType type;
+    int is2D;
     _PDMode7_GridCell **cells;
+    int cellsCapacity;
+    int cellsLength;
+    _PDMode7_Array *freeCells;
     int cellSize;
     int widthLen;
     int heightLen;
     int depthLen;
     int numberOfCells;
+    float spriteBounds;
+    float spriteDepth;
+    float spriteTop;
+    float spriteWidth;
+    float spritePixels;
+    int cellsVisited;
+    int spritesVisited;
 } _PDMode7_Grid;
 
+typedef struct {
+    _PDMode7_GridRange range;
+    PDMode7_Vec2 normals[2];
+    float limits[2];
+    float margin;
+    int numberOfPlanes;
+} _PDMode7_GridView;
+
 typedef enum {
     PDMode7_ShaderTypeLinear,
     PDMode7_ShaderTypeRadial
@@ -142,6 +189,7 @@ typedef enum {
 typedef struct PDMode7_Shader {
     PDMode7_ShaderType objectType;
     void *object;
+    unsigned int version;
     LuaUDObject *luaRef;
 } PDMode7_Shader;
 
@@ -182,6 +230,7 @@ typedef struct PDMode7_Tilemap {
     PDMode7_Tile *tiles;
     PDMode7_Bitmap *fillBitmap;
     uint8_t fillBitmapScale_log;
+    unsigned int version;
     LuaUDObject *luaRef;
 } PDMode7_Tilemap;
 
@@ -193,11 +242,20 @@ typedef struct PDMode7_Background {
     PDMode7_Vec2 center;
     PDMode7_Vec2ui roundingIncrement;
     PDMode7_Display *display;
+    uint8_t *strip;
+    uint8_t *stripMask;
+    int stripRowbytes;
+    int stripDisplayWidth;
+    uint8_t stripValid;
+    PDMode7_Vec2 drawnOffset;
+    int drawnHeight;
+    uint8_t drawnValid;
 } PDMode7_Background;
 
 typedef struct PDMode7_Plane {
     PDMode7_Bitmap *bitmap;
     PDMode7_Color fillColor;
+    PDMode7_AddressMode addressMode;
     PDMode7_Tilemap *tilemap;
 } PDMode7_Plane;
 
@@ -211,6 +269,7 @@ typedef struct PDMode7_World {
     PDMode7_Camera *mainCamera;
     PDMode7_Plane plane;
     PDMode7_Plane ceiling;
+    unsigned int version;
     _PDMode7_Array *sprites;
     _PDMode7_Grid *grid;
 } PDMode7_World;
@@ -221,10 +280,78 @@ typedef struct PDMode7_Camera {
     float fov;
     float pitch;
     int clipDistanceUnits;
+    float farDistance;
+    unsigned int version;
     int isManaged;
     LuaUDObject *luaRef;
 } PDMode7_Camera;
 
+typedef struct {
+    PDMode7_Vec2 screenRatio;
+    float worldScaleInv;
+    float ndc_inf;
+    int planeHeight;
+    int horizon;
+    PDMode7_Vec2 halfFov;
+    PDMode7_Vec2 tanHalfFov;
+    PDMode7_Vec2 fovRatio;
+    PDMode7_Vec3 forwardVec;
+    PDMode7_Vec3 rightVec;
+    PDMode7_Vec3 upVec;
+} _PDMode7_Parameters;
+
+typedef struct {
+    PDMode7_DisplayRenderMode mode;
+    float refreshDistance;
+    float refreshAngle;
+    unsigned int frame;
+    uint8_t valid;
+    uint8_t partial;
+    PDMode7_Camera *camera;
+    PDMode7_Vec3 position;
+    float angle;
+    float pitch;
+    float fov;
+    float farDistance;
+    int horizon;
+    int planeHeight;
+    PDMode7_DisplayScale scale;
+} _PDMode7_Temporal;
+
+typedef struct {
+    PDMode7_World *world;
+    PDMode7_Camera *camera;
+    unsigned int cameraVersion;
+    unsigned int worldVersion;
+    unsigned int planeShaderVersion;
+    unsigned int ceilingShaderVersion;
+    unsigned int tilemapVersion;
+    unsigned int planeVersion;
+    unsigned int ceilingVersion;
+} _PDMode7_FrameKey;
+
+typedef struct {
+    // Framebuffer pixel of display point (u, v) is (x + u * xx + v * yx, y + u * xy + v * yy)
+    int x;
+    int y;
+    int xx;
+    int xy;
+    int yx;
+    int yy;
+    int width;
+    int height;
+} _PDMode7_FrameTransform;
+
+typedef struct {
+    // Framebuffer bytes covered by a display, edge bytes may be shared with other pixels
+    int startY;
+    int endY;
+    int startByte;
+    int length;
+    uint8_t leftMask;
+    uint8_t rightMask;
+} _PDMode7_FrameSpan;
+
 typedef struct PDMode7_Display {
     PDMode7_World *world;
     PDMode7_Rect rect;
@@ -233,9 +360,32 @@ typedef struct PDMode7_Display {
     PDMode7_DisplayOrientation orientation;
     PDMode7_DisplayFlipMode flipMode;
     LCDBitmap *secondaryFramebuffer;
+    uint8_t drawsToSecondary;
+    _PDMode7_FrameTransform frameTransform;
+    uint8_t *lineBuffer;
+    uint8_t *rowColors;
+    struct _PDMode7_RowTable *rowTable;
+    _PDMode7_Parameters parameters;
+    PDMode7_Camera *parametersCamera;
+    unsigned int parametersCameraVersion;
+    uint8_t parametersValid;
+    _PDMode7_Temporal temporal;
+    _PDMode7_FrameKey frameKey;
+    uint8_t *frameCache;
+    int frameCacheFrames;
+    uint8_t frameCacheValid;
+    uint8_t rowDiffing;
+    uint8_t *rowShadow;
+    uint8_t rowShadowValid;
+    int skippedRows;
+    uint8_t *spriteRows;
+    uint8_t *dirtyRows;
     PDMode7_Camera *camera;
     PDMode7_DisplayScale scale;
+    float adaptiveDistance2x;
+    float adaptiveDistance4x;
     _PDMode7_Array *visibleInstances;
+    _PDMode7_Array *closeSprites;
     PDMode7_Background *background;
     PDMode7_Shader *planeShader;
     PDMode7_Shader *ceilingShader;
@@ -262,31 +412,32 @@ typedef struct PDMode7_BitmapLayer {
     LuaUDObject *luaRef;
 } PDMode7_BitmapLayer;
 
+typedef struct {
+    uint8_t *data;
+    int width;
+    int height;
+} _PDMode7_MipLevel;
+
 typedef struct PDMode7_Bitmap {
     uint8_t *data;
     int width;
     int height;
     PDMode7_Bitmap *mask;
     _PDMode7_Array *layers;
+    _PDMode7_MipLevel mips[MODE7_MIP_MAX_LEVELS];
+    int mipLevels;
+    uint8_t *mipData;
+    PDMode7_BitmapLayout layout;
+    int blockColumns;
+    unsigned int version;
+    PDMode7_Rect dirtyRect;
+    unsigned int dirtyVersion;
     uint8_t isManaged;
     uint8_t freeData;
+    uint8_t freeMipData;
     LuaUDObject *luaRef;
 } PDMode7_Bitmap;
 
-typedef struct {
-    PDMode7_Vec2 screenRatio;
-    float worldScaleInv;
-    float ndc_inf;
-    int planeHeight;
-    int horizon;
-    PDMode7_Vec2 halfFov;
-    PDMode7_Vec2 tanHalfFov;
-    PDMode7_Vec2 fovRatio;
-    PDMode7_Vec3 forwardVec;
-    PDMode7_Vec3 rightVec;
-    PDMode7_Vec3 upVec;
-} _PDMode7_Parameters;
-
 typedef struct {
     const uint8_t *data;
     uint8_t len;
@@ -294,9 +445,63 @@ typedef struct {
     uint8_t mod;
 } _PDMode7_DitherPattern;
 
+typedef struct {
+    PDMode7_Vec3 leftPoint;
+    float dxStep;
+    float dyStep;
+    int length;
+    int finite;
+#if PD_MODE7_FIXED_POINT
+    int fixed;
+    int32_t fixedX;
+    int32_t fixedY;
+    int32_t fixedDx;
+    int32_t fixedDy;
+#endif
+} _PDMode7_RowSetup;
+
+typedef struct {
+    int start;
+    int end;
+    uint8_t fillColor;
+} _PDMode7_RowSpan;
+
+typedef struct {
+    _PDMode7_RowSetup row;
+    float distance;
+} _PDMode7_RowTableEntry;
+
+typedef struct {
+    _PDMode7_Parameters parameters;
+    PDMode7_Vec3 position;
+    int width;
+    int xStep;
+    int yStep;
+} _PDMode7_RowTableKey;
+
+typedef struct _PDMode7_RowTable {
+    _PDMode7_RowTableEntry *rows;
+    int capacity;
+    int valid;
+    _PDMode7_RowTableKey key;
+} _PDMode7_RowTable;
+
+typedef void(_PDMode7_RowSampler)(PDMode7_World *world, PDMode7_Plane *plane, PDMode7_Shader *shader, _PDMode7_RowSetup *row, uint8_t *colors, _PDMode7_RowSpan *span, _PDMode7_Parameters *parameters);
+typedef void(_PDMode7_RowWriter)(uint8_t *ptr, const uint8_t *colors, int width, const uint8_t *ditherTable, _PDMode7_RowSpan *span);
+
 static _PDMode7_Pool *pool;
 static _PDMode7_GC *gc;
 
+// Incremented when the data of any bitmap changes
+static unsigned int bitmapVersion = 0;
+
+// Rows marked while drawing all the displays, they're flushed together
+static uint8_t batchedRows[LCD_ROWS];
+static uint8_t batchingRows = 0;
+
+// Incremented for each grid query, sprites store the last query that collected them
+static unsigned int gridQuery = 0;
+
 static const uint8_t patterns2x2[5 * 2] = {
     0b00000000, 0b00000000,
     0b10101010, 0b00000000,
@@ -399,6 +604,10 @@ static const _PDMode7_DitherPattern patterns[3] = {
     { .data = patterns8x8, .len = 65, .mod = 7, .mul = 3}
 };
 
+// Gray to pattern byte, 256 entries for each row phase
+// Built on first use and kept for the lifetime of the library
+static uint8_t *ditherTables[3] = { NULL, NULL, NULL };
+
 static inline int mode7_min(const int a, const int b)
 {
     return a < b ? a : b;
@@ -422,8 +631,11 @@ static inline PDMode7_Rect newRect(int x, int y, int width, int height);
 static int rectIntersect(PDMode7_Rect rectA, PDMode7_Rect rectB);
 static void rectAdjust(PDMode7_Rect rect, int width, int height, PDMode7_Rect *adjustedRect, int *offsetX, int *offsetY);
 static void displaySetCamera(PDMode7_Display *display, PDMode7_Camera *camera);
+static void displayInvalidate(PDMode7_Display *display);
+static void displayInvalidate_public(PDMode7_Display *display);
 static void cameraSetAngle(PDMode7_Camera *camera, float angle);
 static void cameraSetPitch(PDMode7_Camera *camera, float pitch);
+static inline int cameraIsBeyondFarDistance(PDMode7_Camera *camera, float distance);
 static inline PDMode7_Vec2 newVec2(float x, float y);
 static inline PDMode7_Vec3 newVec3(float x, float y, float z);
 static inline PDMode7_Vec2 vec2FromVec3(PDMode7_Vec3 vec);
@@ -435,10 +647,10 @@ static PDMode7_Vec3 displayToPlanePoint(PDMode7_Display *display, int displayX,
 static PDMode7_Vec3 worldToDisplayPoint(PDMode7_Display *display, PDMode7_Vec3 point, _PDMode7_Parameters *p);
 static PDMode7_Vec3 displayMultiplierForScanlineAt(PDMode7_Display *display, PDMode7_Vec3 point, _PDMode7_Parameters *p);
 static inline uint8_t planeColorAt(PDMode7_World *world, PDMode7_Plane *plane, int x, int y);
-static inline void worldSetColor(uint8_t color, PDMode7_DisplayScale displayScale, uint8_t *ptr, int rowbytes, _PDMode7_DitherPattern ditherPattern, int bit, int y, int dy);
+static inline int wrapCoordinate(int value, int size, PDMode7_AddressMode addressMode);
 #if PD_MODE7_SHADER
 static void shaderPrepare(PDMode7_Shader *pShader, PDMode7_Display *display, _PDMode7_Parameters *p);
-static void shaderPrepareRow(PDMode7_Shader *pShader, PDMode7_Display *display, int y, _PDMode7_Parameters *p);
+static void shaderPrepareRow(PDMode7_Shader *pShader, float distance, _PDMode7_Parameters *p);
 static inline void shaderApply(PDMode7_Shader *shader, uint8_t *color, PDMode7_Vec3 point, _PDMode7_Parameters *p);
 static int shaderSpriteIsVisible(PDMode7_Shader *shader, PDMode7_Sprite *sprite, float distance, _PDMode7_Parameters *p);
 #endif
@@ -447,6 +659,16 @@ static void getDisplayScaleStep(PDMode7_DisplayScale scale, int *xStep, int *ySt
 static inline PDMode7_DisplayScale truncatedDisplayScale(PDMode7_DisplayScale scale);
 static PDMode7_Camera* displayGetCamera(PDMode7_Display *display);
 static void displayGetFramebuffer(PDMode7_Display *display, LCDBitmap **target, uint8_t **framebuffer, int *rowbytes);
+static void displayPrepareFramebuffer(PDMode7_Display *display);
+static int displayIsTransformed(PDMode7_Display *display);
+static PDMode7_Rect displayFrameRect(PDMode7_Display *display, PDMode7_Rect rect);
+static int displayFrameSize(PDMode7_Display *display);
+static void displayDrawBitmap(PDMode7_Display *display, LCDBitmap *bitmap, int x, int y);
+static void displayMarkRows(PDMode7_Display *display, int startY, int endY);
+static void displayWriteLine(PDMode7_Display *display, uint8_t *framebuffer, int rowbytes, int y, const uint8_t *line, uint8_t mask);
+static _PDMode7_FrameSpan displayFrameSpan(PDMode7_Display *display);
+static void markFrameRows(int startY, int endY);
+static void flushBatchedRows(void);
 static _PDMode7_Parameters worldGetParameters(PDMode7_Display *display);
 static float worldGetScaleInv(PDMode7_World *pWorld);
 static float worldGetScale(PDMode7_World *pWorld);
@@ -454,6 +676,7 @@ static PDMode7_Display* getDisplay(PDMode7_World *pWorld, PDMode7_Display *displ
 static PDMode7_Vec2 backgroundGetOffset(PDMode7_Background *background, _PDMode7_Parameters *parameters);
 static void spriteSetPosition(PDMode7_Sprite *sprite, float x, float y, float z);
 static void spriteBoundsDidChange(PDMode7_Sprite *sprite);
+static void spriteExtentsDidChange(PDMode7_Sprite *sprite);
 static unsigned int spriteGetTableIndex(PDMode7_SpriteInstance *instance, unsigned int angleIndex, unsigned int pitchIndex, int unsigned scaleIndex);
 static void removeSprite(PDMode7_Sprite *sprite);
 static int sortSprites(const void *a, const void *b);
@@ -462,12 +685,26 @@ static float roundToIncrement(float number, unsigned int multiple);
 static PDMode7_Vec3 vec3_subtract(PDMode7_Vec3 v1, PDMode7_Vec3 v2);
 static float vec3_dot(PDMode7_Vec3 v1, PDMode7_Vec3 v2);
 static inline PDMode7_Color newGrayscaleColor(uint8_t gray, uint8_t alpha);
-static _PDMode7_Grid* newGrid(float width, float height, float depth, int cellSize);
+static _PDMode7_Grid* newGrid(float width, float height, float depth, int cellSize, PDMode7_GridType type, int is2D);
 static void gridRemoveSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite);
+static _PDMode7_GridCell* newGridCell(int index);
+static void gridResizeCells(_PDMode7_Grid *grid, int capacity);
+static _PDMode7_GridCell* gridCellAt(_PDMode7_Grid *grid, int index);
 static void gridUpdateSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite);
-static _PDMode7_Array* gridGetSpritesAtPoint(_PDMode7_Grid *grid, PDMode7_Vec3 point, int distanceUnits);
+static void gridIncludeSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite);
+static _PDMode7_GridRange gridRangeAtPoint(_PDMode7_Grid *grid, PDMode7_Vec3 point, int distanceUnits);
+static _PDMode7_GridView gridViewForDisplay(_PDMode7_Grid *grid, PDMode7_Display *display, _PDMode7_Parameters *p);
+static int gridViewsCellCount(_PDMode7_Grid *grid, _PDMode7_GridView **views, int numberOfViews);
+static int gridViewIntersectsRange(_PDMode7_Grid *grid, _PDMode7_GridView *view, _PDMode7_GridRange *range);
+static void gridGetSpritesInViews(_PDMode7_Grid *grid, _PDMode7_GridView **views, int numberOfViews, _PDMode7_Array *results);
+static int gridRangeIntersects(_PDMode7_GridRange *rangeA, _PDMode7_GridRange *rangeB);
+static _PDMode7_GridRange gridRangeUnion(_PDMode7_GridRange *rangeA, _PDMode7_GridRange *rangeB);
 static void releaseBitmap(PDMode7_Bitmap *bitmap);
 static void freeBitmap(PDMode7_Bitmap *bitmap);
+static void bitmapGenerateMipmaps(PDMode7_Bitmap *bitmap);
+static void bitmapUpdateMipmaps(PDMode7_Bitmap *bitmap, PDMode7_Rect rect);
+static void bitmapDidChange(PDMode7_Bitmap *bitmap, PDMode7_Rect rect);
+static void bitmapClearDirtyRect(PDMode7_Bitmap *bitmap);
 static void bitmapLayerSetBitmap(PDMode7_BitmapLayer *layer, PDMode7_Bitmap *bitmap);
 static void bitmapLayerDidChange(PDMode7_BitmapLayer *layer);
 static void bitmapLayerDraw(PDMode7_BitmapLayer *layer);
@@ -482,8 +719,10 @@ static _PDMode7_Callback* newCallback_c(void *function);
 static _PDMode7_Callback* newCallback_lua(const char *functionName);
 static void freeCallback(_PDMode7_Callback *callback);
 static _PDMode7_Array* newArray(void);
+static void arrayReserve(_PDMode7_Array *array, int capacity);
 static void arrayPush(_PDMode7_Array *array, void *item);
 static void arrayRemove(_PDMode7_Array *array, int index);
+static void arraySwapRemove(_PDMode7_Array *array, int index);
 static int arrayIndexOf(_PDMode7_Array *array, void *item);
 static void arrayClear(_PDMode7_Array *array);
 static void freeArray(_PDMode7_Array *array);
@@ -509,6 +748,7 @@ static PDMode7_World* worldWithConfiguration(PDMode7_WorldConfiguration configur
     
     world->plane = newPlane();
     world->ceiling = newPlane();
+    world->version = 0;
     
     world->sprites = newArray();
     world->numberOfDisplays = 0;
@@ -519,12 +759,12 @@ static PDMode7_World* worldWithConfiguration(PDMode7_WorldConfiguration configur
     
     displaySetCamera(world->mainDisplay, world->mainCamera);
     
-    world->grid = newGrid(configuration.width, configuration.height, configuration.depth, configuration.gridCellSize);
+    world->grid = newGrid(configuration.width, configuration.height, configuration.depth, configuration.gridCellSize, configuration.gridType, configuration.grid2D);
     
     return world;
 }
 
-static PDMode7_World* worldWithParameters(float width, float height, float depth, int gridCellSize)
+static PDMode7_World* worldWithParameters(float width, float height, float depth, int gridCellSize, PDMode7_GridType gridType, int grid2D)
 {
     PDMode7_WorldConfiguration configuration = defaultWorldConfiguration();
     
@@ -544,6 +784,8 @@ static PDMode7_World* worldWithParameters(float width, float height, float depth
     {
         configuration.gridCellSize = gridCellSize;
     }
+    configuration.gridType = gridType;
+    configuration.grid2D = grid2D;
     return worldWithConfiguration(configuration);
 }
 
@@ -553,11 +795,13 @@ static PDMode7_WorldConfiguration defaultWorldConfiguration(void)
         .width = 1024,
         .height = 1024,
         .depth = 1024,
-        .gridCellSize = 256
+        .gridCellSize = 256,
+        .gridType = kMode7GridTypeDense,
+        .grid2D = 0
     };
 }
 
-static _PDMode7_Parameters worldGetParameters(PDMode7_Display *display)
+static _PDMode7_Parameters displayComputeParameters(PDMode7_Display *display)
 {
     PDMode7_World *pWorld = display->world;
     PDMode7_Camera *camera = display->camera;
@@ -615,16 +859,36 @@ static _PDMode7_Parameters worldGetParameters(PDMode7_Display *display)
     };
 }
 
+static _PDMode7_Parameters worldGetParameters(PDMode7_Display *display)
+{
+    PDMode7_Camera *camera = display->camera;
+    
+    // Parameters are recomputed only when the camera or the rect change
+    if(!display->parametersValid || display->parametersCamera != camera || display->parametersCameraVersion != camera->version)
+    {
+        display->parameters = displayComputeParameters(display);
+        display->parametersCamera = camera;
+        display->parametersCameraVersion = camera->version;
+        display->parametersValid = 1;
+    }
+    
+    // World scale depends on the plane bitmap, it's cheap to read
+    display->parameters.worldScaleInv = worldGetScaleInv(display->world);
+    
+    return display->parameters;
+}
+
 static PDMode7_Plane newPlane(void)
 {
     return (PDMode7_Plane){
         .bitmap = NULL,
         .fillColor = newGrayscaleColor(255, 255),
+        .addressMode = kMode7AddressModeFill,
         .tilemap = NULL
     };
 }
 
-static void worldUpdateDisplay(PDMode7_World *world, PDMode7_Display *display)
+static void worldUpdateDisplay(PDMode7_World *world, PDMode7_Display *display, _PDMode7_Array *closeSprites, _PDMode7_GridView *view)
 {
     int displayIndex = indexForDisplay(world, display);
     if(displayIndex < 0)
@@ -639,13 +903,16 @@ static void worldUpdateDisplay(PDMode7_World *world, PDMode7_Display *display)
     // Clear the visible sprites for current display
     arrayClear(display->visibleInstances);
     
-    // Get the close sprites from the grid
-    _PDMode7_Array *closeSprites = gridGetSpritesAtPoint(world->grid, camera->position, camera->clipDistanceUnits);
-    
     for(int i = 0; i < closeSprites->length; i++)
     {
         PDMode7_Sprite *sprite = closeSprites->items[i];
         
+        // Shared results may include sprites outside of this display view
+        if(view && !gridViewIntersectsRange(world->grid, view, &sprite->gridRange))
+        {
+            continue;
+        }
+        
         PDMode7_SpriteInstance *instance = sprite->instances[displayIndex];
         PDMode7_SpriteDataSource *dataSource = instance->dataSource;
 
@@ -656,7 +923,7 @@ static void worldUpdateDisplay(PDMode7_World *world, PDMode7_Display *display)
             
             // Calculate local point
             float distance = vec3_dot(viewVec, parameters.forwardVec);
-            uint8_t visible = (distance > 0);
+            uint8_t visible = (distance > 0 && !cameraIsBeyondFarDistance(camera, distance));
 #if PD_MODE7_SHADER
             if(visible && instance->visibilityMode == kMode7SpriteVisibilityModeShader)
             {
@@ -797,8 +1064,6 @@ static void worldUpdateDisplay(PDMode7_World *world, PDMode7_Display *display)
     }
     
     qsort(display->visibleInstances->items, display->visibleInstances->length, sizeof(PDMode7_SpriteInstance*), sortSprites);
-    
-    freeArray(closeSprites);
 }
 
 static int sortSprites(const void *a, const void *b)
@@ -861,241 +1126,1778 @@ static float worldGetRelativePitch(PDMode7_Vec3 cameraPoint, float cameraPitch,
 
 static void worldUpdate(PDMode7_World *world)
 {
+    _PDMode7_GridView views[MODE7_MAX_DISPLAYS];
+    _PDMode7_GridView *groupViews[MODE7_MAX_DISPLAYS][MODE7_MAX_DISPLAYS];
+    _PDMode7_GridRange groupRanges[MODE7_MAX_DISPLAYS];
+    int groupLengths[MODE7_MAX_DISPLAYS];
+    int groups[MODE7_MAX_DISPLAYS];
+    
+    world->grid->cellsVisited = 0;
+    world->grid->spritesVisited = 0;
+    
+    // Displays with overlapping views share a grid query
+    // Views are merged only if the merged query doesn't visit more cells than the separate ones
     for(int i = 0; i < world->numberOfDisplays; i++)
     {
         PDMode7_Display *display = world->displays[i];
-        worldUpdateDisplay(world, display);
+        _PDMode7_Parameters parameters = worldGetParameters(display);
+        views[i] = gridViewForDisplay(world->grid, display, &parameters);
+        groups[i] = i;
+        groupViews[i][0] = &views[i];
+        groupLengths[i] = 1;
+        groupRanges[i] = views[i].range;
+        
+        for(int j = 0; j < i; j++)
+        {
+            if(groups[j] == j && gridRangeIntersects(&groupRanges[j], &views[i].range))
+            {
+                int separateCount = gridViewsCellCount(world->grid, groupViews[j], groupLengths[j]) + gridViewsCellCount(world->grid, &groupViews[i][0], 1);
+                groupViews[j][groupLengths[j]] = &views[i];
+                if(gridViewsCellCount(world->grid, groupViews[j], groupLengths[j] + 1) <= separateCount)
+                {
+                    groups[i] = j;
+                    groupLengths[j]++;
+                    groupRanges[j] = gridRangeUnion(&groupRanges[j], &views[i].range);
+                    break;
+                }
+            }
+        }
     }
-}
-
-static void drawBackground(PDMode7_Display *display, _PDMode7_Parameters *parameters)
-{
-    PDMode7_Background *background = display->background;
-
-    if(!background->bitmap)
+    
+    for(int i = 0; i < world->numberOfDisplays; i++)
     {
-        return;
+        if(groups[i] != i)
+        {
+            continue;
+        }
+        
+        // Results are kept in the first display of the group, the buffer is reused every frame
+        _PDMode7_Array *closeSprites = world->displays[i]->closeSprites;
+        gridGetSpritesInViews(world->grid, groupViews[i], groupLengths[i], closeSprites);
+        
+        // Results are filtered only if the group merged different views
+        int sameView = 1;
+        for(int j = 1; j < groupLengths[i]; j++)
+        {
+            if(memcmp(groupViews[i][j], groupViews[i][0], sizeof(_PDMode7_GridView)) != 0)
+            {
+                sameView = 0;
+                break;
+            }
+        }
+        
+        for(int j = i; j < world->numberOfDisplays; j++)
+        {
+            if(groups[j] == i)
+            {
+                worldUpdateDisplay(world, world->displays[j], closeSprites, sameView ? NULL : &views[j]);
+            }
+        }
     }
-    
-    PDMode7_Vec2 offset = backgroundGetOffset(background, parameters);
-    
-    LCDBitmap *target;
-    displayGetFramebuffer(display, &target, NULL, NULL);
-    
-    playdate->graphics->pushContext(target);
-    playdate->graphics->setClipRect(display->rect.x, display->rect.y, display->rect.width, parameters->horizon);
+}
 
-    playdate->graphics->drawBitmap(background->bitmap, display->rect.x + offset.x, offset.y, kBitmapUnflipped);
-    
-    if(offset.x > 0)
+static void worldGetQueryStats(PDMode7_World *world, int *cells, int *sprites)
+{
+    // Cells and sprite references visited by the grid queries in the last update
+    if(cells)
     {
-        int offsetX2 = offset.x - background->width;
-        playdate->graphics->drawBitmap(background->bitmap, display->rect.x + offsetX2, offset.y, kBitmapUnflipped);
+        *cells = world->grid->cellsVisited;
     }
-    
-    int maxOffset = -background->width + display->rect.width - offset.x;
-    if(maxOffset > 0)
+    if(sprites)
     {
-        int offsetX2 = display->rect.width - maxOffset;
-        playdate->graphics->drawBitmap(background->bitmap, display->rect.x + offsetX2, offset.y, kBitmapUnflipped);
+        *sprites = world->grid->spritesVisited;
     }
-    
-    playdate->graphics->popContext();
 }
 
-static void drawPlane(PDMode7_World *world, PDMode7_Display *display, _PDMode7_Parameters *parameters)
+static void backgroundPrepareStrip(PDMode7_Background *background, int displayWidth)
 {
-    LCDBitmap *target; uint8_t *framebuffer; int rowbytes;
-    displayGetFramebuffer(display, &target, &framebuffer, &rowbytes);
-    
-    // Set the framebuffer initial offset
-    int startY = display->rect.y + parameters->horizon;
-    uint8_t *frameStart = framebuffer + startY * rowbytes + display->rect.x / 8;
-    int frameY = 0;
-
-    int xStep; int yStep;
-    getDisplayScaleStep(display->scale, &xStep, &yStep);
-    
-    // Pre-calculate displayWidth
-    float displayWidthInv = 1.0f / display->rect.width * xStep;
+    if(background->stripValid && background->stripDisplayWidth == displayWidth)
+    {
+        return;
+    }
     
-    // Calculate the framebuffer increment
-    int rowSize = rowbytes * yStep;
+    int width; int height; int rowbytes; uint8_t *mask; uint8_t *data;
+    playdate->graphics->getBitmapData(background->bitmap, &width, &height, &rowbytes, &mask, &data);
     
-    // Pattern
-    int ditherType = (display->ditherType >= 0 && display->ditherType < 3) ? display->ditherType : 0;
-    _PDMode7_DitherPattern ditherPattern = patterns[ditherType];
+    // The bitmap is repeated horizontally, so that any display row is a single span of the strip
+    int stripRowbytes = (width + 7) / 8 + displayWidth / 8 + 1;
+    int size = stripRowbytes * height;
+    background->strip = playdate->system->realloc(background->strip, size);
+    background->stripMask = playdate->system->realloc(background->stripMask, mask ? size : 0);
+    background->stripRowbytes = stripRowbytes;
+    background->stripDisplayWidth = displayWidth;
+    background->stripValid = 1;
     
-    for(int y = 0; y < parameters->planeHeight; y += yStep)
+    for(int y = 0; y < height; y++)
     {
-        int relativeY = parameters->horizon + y;
-        int absoluteY = display->rect.y + relativeY;
-        
-        // Left point for the scanline
-        PDMode7_Vec3 leftPoint = displayToPlanePoint(display, 0, relativeY, parameters);
-        leftPoint.x *= parameters->worldScaleInv;
-        leftPoint.y *= parameters->worldScaleInv;
+        uint8_t *dataRow = data + y * rowbytes;
+        uint8_t *maskRow = mask ? (mask + y * rowbytes) : NULL;
+        uint8_t *stripRow = background->strip + y * stripRowbytes;
+        uint8_t *stripMaskRow = mask ? (background->stripMask + y * stripRowbytes) : NULL;
         
-        // Right point for the scanline
-        PDMode7_Vec3 rightPoint = displayToPlanePoint(display, display->rect.width, relativeY, parameters);
-        rightPoint.x *= parameters->worldScaleInv;
-        rightPoint.y *= parameters->worldScaleInv;
-        
-        // Calculate the delta between the scanline points
-        // Then divide it by the display width
-        float dxStep = (rightPoint.x - leftPoint.x) * displayWidthInv;
-        float dyStep = (rightPoint.y - leftPoint.y) * displayWidthInv;
-        
-        // Set the initial framebuffer offset and bit position
-        int frameX = 0;
-        int bitPosition = 0;
-        
-        // If y exceeds display height, get truncated scale
-        PDMode7_DisplayScale planeScale = display->scale;
-        if((relativeY + yStep) > display->rect.height)
-        {
-            planeScale = truncatedDisplayScale(planeScale);
-        }
-        
-#if PD_MODE7_CEILING
-        int ceilingRelativeY = parameters->horizon - y;
-        PDMode7_DisplayScale ceilingScale = display->scale;
-        if((ceilingRelativeY - yStep) < 0)
-        {
-            ceilingScale = truncatedDisplayScale(ceilingScale);
-        }
-#endif
-#if PD_MODE7_SHADER
-        shaderPrepareRow(display->planeShader, display, y, parameters);
-#if PD_MODE7_CEILING
-        shaderPrepareRow(display->ceilingShader, display, y, parameters);
-#endif
-#endif
-        // Advance pointLeft in the loop
-        for(int x = 0; x < display->rect.width; x += xStep)
+        for(int i = 0; i < stripRowbytes; i++)
         {
-            int mapX = floorf(leftPoint.x);
-            int mapY = floorf(leftPoint.y);
-            
-            uint8_t color = planeColorAt(world, &world->plane, mapX, mapY);
-#if PD_MODE7_SHADER
-            shaderApply(display->planeShader, &color, leftPoint, parameters);
-#endif
-            worldSetColor(color, planeScale, frameStart + frameY + frameX, rowbytes, ditherPattern, bitPosition, absoluteY, 1);
-            
-#if PD_MODE7_CEILING
-            if((world->ceiling.bitmap || world->ceiling.tilemap) && ceilingRelativeY > 0)
+            uint8_t byte = 0;
+            uint8_t maskByte = 0;
+            for(int b = 0; b < 8; b++)
             {
-                uint8_t ceilingColor = planeColorAt(world, &world->ceiling, mapX, mapY);
-#if PD_MODE7_SHADER
-                shaderApply(display->ceilingShader, &ceilingColor, leftPoint, parameters);
-#endif
-                worldSetColor(ceilingColor, ceilingScale, frameStart - frameY - rowbytes + frameX, -rowbytes, ditherPattern, bitPosition, absoluteY - 1, -1);
+                int x = (i * 8 + b) % width;
+                uint8_t bit = 0x80 >> (x & 7);
+                byte = (byte << 1) | ((dataRow[x / 8] & bit) ? 1 : 0);
+                if(maskRow)
+                {
+                    maskByte = (maskByte << 1) | ((maskRow[x / 8] & bit) ? 1 : 0);
+                }
             }
-#endif
-            // Advance the point by the step
-            leftPoint.x += dxStep;
-            leftPoint.y += dyStep;
-                        
-            bitPosition += xStep;
-            
-            if(bitPosition == 8)
+            stripRow[i] = byte;
+            if(stripMaskRow)
             {
-                // Increment the framebuffer offset and reset bitPosition
-                frameX++;
-                bitPosition = 0;
+                stripMaskRow[i] = maskByte;
             }
         }
-        
-        // Increment the framebuffer index
-        frameY += rowSize;
-    }
-    
-    if(!target)
-    {
-        int absoluteHorizon = display->rect.y + parameters->horizon;
-        int startY = absoluteHorizon;
-#if PD_MODE7_CEILING
-        startY = mode7_max(absoluteHorizon - parameters->planeHeight, 0);
-#endif
-        playdate->graphics->markUpdatedRows(startY, absoluteHorizon + parameters->planeHeight - 1);
     }
 }
 
-static void drawSprite(PDMode7_SpriteInstance *instance)
+static void drawBackground(PDMode7_Display *display, _PDMode7_Parameters *parameters, int height)
 {
-    if(instance->bitmap)
-    {
-        playdate->graphics->drawBitmap(instance->bitmap, instance->displayRect.x, instance->displayRect.y, kBitmapUnflipped);
-    }
-}
+    PDMode7_Background *background = display->background;
 
-static void drawSprites(PDMode7_Display *display)
-{
-    for(int i = 0; i < display->visibleInstances->length; i++)
+    if(!background->bitmap || background->width <= 0)
     {
-        PDMode7_SpriteInstance *instance = display->visibleInstances->items[i];
-        
-        if(instance->drawCallback)
+        return;
+    }
+    
+    PDMode7_Vec2 offset = backgroundGetOffset(background, parameters);
+    
+    LCDBitmap *target; uint8_t *framebuffer; int rowbytes;
+    displayGetFramebuffer(display, &target, &framebuffer, &rowbytes);
+    
+    // Temporal modes keep the framebuffer between frames, the background is still there if it didn't move
+    // Rows covered by sprites in the last frame are drawn again
+    int retained = (display->temporal.partial && !target && !displayIsTransformed(display) && background->drawnValid && background->drawnOffset.x == offset.x && background->drawnOffset.y == offset.y && background->drawnHeight == height);
+    background->drawnOffset = offset;
+    background->drawnHeight = height;
+    background->drawnValid = 1;
+    
+    backgroundPrepareStrip(background, display->rect.width);
+    
+    // The wrap split is the same for all the rows, each row is copied from this strip column
+    int offsetX = display->rect.x + offset.x;
+    int offsetY = offset.y;
+    int stripX = ((display->rect.x - offsetX) % background->width + background->width) % background->width;
+    int stripByte = stripX / 8;
+    int shift = stripX & 7;
+    
+    // Up to three copies are drawn, as with drawBitmap, a narrow background doesn't cover the whole width
+    int coverStart = (offset.x > 0) ? (offsetX - background->width) : offsetX;
+    int coverEnd = offsetX + ((offset.x + background->width < display->rect.width) ? 2 : 1) * background->width;
+    coverStart = mode7_max(coverStart - display->rect.x, 0);
+    coverEnd = mode7_min(coverEnd - display->rect.x, display->rect.width);
+    int coverFirst = coverStart / 8;
+    int coverLast = (coverEnd > coverStart) ? (coverEnd - 1) / 8 : -1;
+    uint8_t coverLeftMask = 0xFF >> (coverStart & 7);
+    uint8_t coverRightMask = 0xFF << (7 - ((coverEnd - 1) & 7));
+    
+    int startY = mode7_max(offsetY, display->rect.y);
+    int endY = mode7_min(offsetY + background->height, display->rect.y + height);
+    
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    uint8_t *lineBuffer = display->lineBuffer;
+    int length = display->rect.width / 8;
+    
+    // Display rows are framebuffer rows, they're clipped to the framebuffer width
+    int frameByte = (t->x + display->rect.x) / 8;
+    int start = mode7_max(-frameByte, 0);
+    int end = mode7_min(length, t->width / 8 - frameByte);
+    
+    int runStart = -1;
+    for(int y = startY; y <= endY; y++)
+    {
+        int draw = (y < endY && !(retained && !display->spriteRows[y - display->rect.y]));
+        if(draw)
         {
-            switch(instance->drawCallback->type)
+            int stripOffset = (y - offsetY) * background->stripRowbytes + stripByte;
+            uint8_t *src = background->strip + stripOffset;
+            uint8_t *srcMask = background->stripMask ? (background->stripMask + stripOffset) : NULL;
+            
+            if(t->xx == 1)
             {
-                case _PDMode7_CallbackTypeC:
+                int frameY = t->y + y * t->yy;
+                if(frameY >= 0 && frameY < t->height)
                 {
-                    PDMode7_SpriteDrawCallbackFunction *drawFunction = instance->drawCallback->cFunction;
-                    drawFunction(instance, instance->bitmap, instance->displayRect, drawSprite);
-                    break;
+                    uint8_t *ptr = framebuffer + frameY * rowbytes + frameByte;
+                    int first = mode7_max(start, coverFirst);
+                    int last = mode7_min(end - 1, coverLast);
+                    for(int i = first; i <= last; i++)
+                    {
+                        uint8_t byte = (src[i] << shift) | (src[i + 1] >> (8 - shift));
+                        uint8_t maskByte = srcMask ? ((srcMask[i] << shift) | (srcMask[i + 1] >> (8 - shift))) : 0xFF;
+                        maskByte &= (i == coverFirst) ? coverLeftMask : 0xFF;
+                        maskByte &= (i == coverLast) ? coverRightMask : 0xFF;
+                        ptr[i] = (ptr[i] & ~maskByte) | (byte & maskByte);
+                    }
                 }
-                case _PDMode7_CallbackTypeLua:
+            }
+            else
+            {
+                // Transformed displays are cleared to white before the background
+                for(int i = 0; i < length; i++)
                 {
-                    lua_spriteCallDrawCallback(instance);
-                    break;
+                    uint8_t byte = 0xFF;
+                    if(i >= coverFirst && i <= coverLast)
+                    {
+                        byte = (src[i] << shift) | (src[i + 1] >> (8 - shift));
+                        uint8_t maskByte = srcMask ? ((srcMask[i] << shift) | (srcMask[i + 1] >> (8 - shift))) : 0xFF;
+                        maskByte &= (i == coverFirst) ? coverLeftMask : 0xFF;
+                        maskByte &= (i == coverLast) ? coverRightMask : 0xFF;
+                        byte = (byte & maskByte) | ~maskByte;
+                    }
+                    lineBuffer[i] = byte;
                 }
+                displayWriteLine(display, framebuffer, rowbytes, y, lineBuffer, 0xFF);
             }
         }
-        else
+        
+        if(draw && runStart < 0)
         {
-            drawSprite(instance);
+            runStart = y;
+        }
+        else if(!draw && runStart >= 0)
+        {
+            if(!target)
+            {
+                displayMarkRows(display, runStart, y - 1);
+            }
+            runStart = -1;
         }
     }
 }
 
-static void worldDraw(PDMode7_World *pWorld, PDMode7_Display *display)
+static void rowSetupInit(_PDMode7_RowSetup *row, PDMode7_Vec3 leftPoint, PDMode7_Vec3 rightPoint, float dxStep, float dyStep, int length)
 {
-    display = getDisplay(pWorld, display);
-    int displayIndex = indexForDisplay(pWorld, display);
-    if(displayIndex < 0)
+    row->leftPoint = leftPoint;
+    row->dxStep = dxStep;
+    row->dyStep = dyStep;
+    row->length = length;
+    row->finite = (isfinite(leftPoint.x) && isfinite(leftPoint.y) && isfinite(dxStep) && isfinite(dyStep));
+#if PD_MODE7_FIXED_POINT
+    // Use fixed-point stepping if both endpoints are in range
+    row->fixed = (fabsf(leftPoint.x) < MODE7_FIXED_LIMIT && fabsf(leftPoint.y) < MODE7_FIXED_LIMIT && fabsf(rightPoint.x) < MODE7_FIXED_LIMIT && fabsf(rightPoint.y) < MODE7_FIXED_LIMIT);
+    if(row->fixed)
+    {
+        row->fixedX = (int32_t)roundf(leftPoint.x * MODE7_FIXED_ONE);
+        row->fixedY = (int32_t)roundf(leftPoint.y * MODE7_FIXED_ONE);
+        row->fixedDx = (int32_t)roundf(dxStep * MODE7_FIXED_ONE);
+        row->fixedDy = (int32_t)roundf(dyStep * MODE7_FIXED_ONE);
+    }
+#endif
+}
+
+static inline PDMode7_Vec3 rowPointAt(_PDMode7_RowSetup *row, int i)
+{
+    // Points are computed from the index, not accumulated, so the same sample is always at the same position
+    return newVec3(row->leftPoint.x + i * row->dxStep, row->leftPoint.y + i * row->dyStep, row->leftPoint.z);
+}
+
+static inline void rowMapAt(_PDMode7_RowSetup *row, int i, int *mapX, int *mapY)
+{
+#if PD_MODE7_FIXED_POINT
+    if(row->fixed)
     {
+        // Arithmetic shift floors negative values
+        *mapX = (int32_t)(row->fixedX + (int64_t)i * row->fixedDx) >> MODE7_FIXED_SHIFT;
+        *mapY = (int32_t)(row->fixedY + (int64_t)i * row->fixedDy) >> MODE7_FIXED_SHIFT;
         return;
     }
-    
+#endif
+    PDMode7_Vec3 point = rowPointAt(row, i);
+    *mapX = floorf(point.x);
+    *mapY = floorf(point.y);
+}
+
+static inline int rowSampleInBounds(_PDMode7_RowSetup *row, int i, int width, int height)
+{
+#if PD_MODE7_FIXED_POINT
+    if(row->fixed)
+    {
+        int32_t x = (int32_t)(row->fixedX + (int64_t)i * row->fixedDx);
+        int32_t y = (int32_t)(row->fixedY + (int64_t)i * row->fixedDy);
+        return (x >= 0 && (x >> MODE7_FIXED_SHIFT) < width && y >= 0 && (y >> MODE7_FIXED_SHIFT) < height);
+    }
+#endif
+    PDMode7_Vec3 point = rowPointAt(row, i);
+    return (point.x >= 0 && point.x < width && point.y >= 0 && point.y < height);
+}
+
+static inline void rowBoundsForAxis(float p, float d, float size, float *lo, float *hi)
+{
+    // Samples i such that 0 <= p + i * d < size
+    if(d > 0)
+    {
+        *lo = fmaxf(*lo, -p / d);
+        *hi = fminf(*hi, (size - p) / d);
+    }
+    else if(d < 0)
+    {
+        *lo = fmaxf(*lo, (size - p) / d);
+        *hi = fminf(*hi, -p / d);
+    }
+    else if(p < 0 || p >= size)
+    {
+        *lo = 0;
+        *hi = 0;
+    }
+}
+
+static inline int rowIntersectsRect(_PDMode7_RowSetup *row, PDMode7_Rect rect)
+{
+    if(!row->finite || rect.width <= 0 || rect.height <= 0)
+    {
+        return 0;
+    }
+    
+    float lo = 0; float hi = row->length;
+    rowBoundsForAxis(row->leftPoint.x - rect.x, row->dxStep, rect.width, &lo, &hi);
+    rowBoundsForAxis(row->leftPoint.y - rect.y, row->dyStep, rect.height, &lo, &hi);
+    
+    return ceilf(fmaxf(lo, 0)) < hi;
+}
+
+static void rowClipToBounds(_PDMode7_RowSetup *row, int width, int height, int *start, int *end)
+{
+    *start = 0;
+    *end = 0;
+    
+    if(!row->finite)
+    {
+        return;
+    }
+    
+    // Analytic intersection of the scanline with the bounds
+    float lo = 0; float hi = row->length;
+    rowBoundsForAxis(row->leftPoint.x, row->dxStep, width, &lo, &hi);
+    rowBoundsForAxis(row->leftPoint.y, row->dyStep, height, &lo, &hi);
+    
+    lo = fminf(fmaxf(lo, 0), row->length);
+    hi = fminf(fmaxf(hi, lo), row->length);
+    
+    int s = ceilf(lo);
+    int e = mode7_max(s, ceilf(hi));
+    
+    // Snap the interval to the exact sample positions
+    // Coordinates are monotonic along the row, so samples in bounds are contiguous
+    while(s > 0 && rowSampleInBounds(row, s - 1, width, height)) s--;
+    while(s < e && !rowSampleInBounds(row, s, width, height)) s++;
+    while(e < row->length && rowSampleInBounds(row, e, width, height)) e++;
+    while(e > s && !rowSampleInBounds(row, e - 1, width, height)) e--;
+    
+    *start = s;
+    *end = e;
+}
+
+static inline int blockOffset(int x, int y, int columns)
+{
+    // Tiled bitmaps are stored in 8x8 blocks, each block is stored row by row
+    const int log = MODE7_BITMAP_BLOCK_LOG;
+    const int mask = (1 << log) - 1;
+    return (((y >> log) * columns + (x >> log)) << (log * 2)) + ((y & mask) << log) + (x & mask);
+}
+
+static inline int bitmapOffset(PDMode7_Bitmap *bitmap, int x, int y)
+{
+    if(bitmap->layout == kMode7BitmapLayoutTiled)
+    {
+        return blockOffset(x, y, bitmap->blockColumns);
+    }
+    return y * bitmap->width + x;
+}
+
+static inline uint8_t bitmapMipTexel(PDMode7_Bitmap *bitmap, int lod, int x, int y)
+{
+    // Mip levels are always linear
+    if(lod > 0)
+    {
+        _PDMode7_MipLevel *mip = &bitmap->mips[lod - 1];
+        return mip->data[y * mip->width + x];
+    }
+    return bitmap->data[bitmapOffset(bitmap, x, y)];
+}
+
+static inline const uint8_t* bitmapMipData(PDMode7_Bitmap *bitmap, int lod, int *width, int *height)
+{
+    if(lod > 0)
+    {
+        _PDMode7_MipLevel *mip = &bitmap->mips[lod - 1];
+        *width = mip->width;
+        *height = mip->height;
+        return mip->data;
+    }
+    *width = bitmap->width;
+    *height = bitmap->height;
+    return bitmap->data;
+}
+
+static inline int rowMipLevel(_PDMode7_RowSetup *row)
+{
+    // Level n is picked when a sample covers at least 2^n texels
+    float footprint = fmaxf(fabsf(row->dxStep), fabsf(row->dyStep));
+    int level = 0;
+    while(footprint >= 2.0f && level < 16)
+    {
+        footprint *= 0.5f;
+        level++;
+    }
+    return level;
+}
+
+static void sampleTiledBitmapRow(PDMode7_Bitmap *bitmap, _PDMode7_RowSetup *row, int start, int end, uint8_t *colors)
+{
+    // Samples are in bounds, no checks needed
+    const uint8_t *data = bitmap->data;
+    int columns = bitmap->blockColumns;
+#if PD_MODE7_FIXED_POINT
+    if(row->fixed)
+    {
+        int32_t x = (int32_t)(row->fixedX + (int64_t)start * row->fixedDx);
+        int32_t y = (int32_t)(row->fixedY + (int64_t)start * row->fixedDy);
+        for(int i = start; i < end; i++)
+        {
+            colors[i] = data[blockOffset(x >> MODE7_FIXED_SHIFT, y >> MODE7_FIXED_SHIFT, columns)];
+            x += row->fixedDx;
+            y += row->fixedDy;
+        }
+        return;
+    }
+#endif
+    for(int i = start; i < end; i++)
+    {
+        PDMode7_Vec3 point = rowPointAt(row, i);
+        colors[i] = data[blockOffset((int)point.x, (int)point.y, columns)];
+    }
+}
+
+static inline void sampleBitmapRow(PDMode7_Bitmap *bitmap, _PDMode7_RowSetup *row, int lod, int start, int end, uint8_t *colors)
+{
+    if(lod == 0 && bitmap->layout == kMode7BitmapLayoutTiled)
+    {
+        sampleTiledBitmapRow(bitmap, row, start, end, colors);
+        return;
+    }
+    
+    // Samples are in bounds, no checks needed
+    // Bounds are checked at level 0, a level texel is the level 0 texel shifted by lod
+    int width; int height;
+    const uint8_t *data = bitmapMipData(bitmap, lod, &width, &height);
+#if PD_MODE7_FIXED_POINT
+    if(row->fixed)
+    {
+        int shift = MODE7_FIXED_SHIFT + lod;
+        int32_t x = (int32_t)(row->fixedX + (int64_t)start * row->fixedDx);
+        int32_t y = (int32_t)(row->fixedY + (int64_t)start * row->fixedDy);
+        for(int i = start; i < end; i++)
+        {
+            colors[i] = data[(y >> shift) * width + (x >> shift)];
+            x += row->fixedDx;
+            y += row->fixedDy;
+        }
+        return;
+    }
+#endif
+    float scale = 1.0f / (1 << lod);
+    for(int i = start; i < end; i++)
+    {
+        // Coordinates are positive, truncation is floor
+        PDMode7_Vec3 point = rowPointAt(row, i);
+        colors[i] = data[(int)(point.y * scale) * width + (int)(point.x * scale)];
+    }
+}
+
+static void sampleBitmapRowWrapped(PDMode7_Bitmap *bitmap, PDMode7_AddressMode addressMode, _PDMode7_RowSetup *row, int lod, uint8_t *colors)
+{
+    // The period must be a whole number of texels in the level
+    while(lod > 0 && ((bitmap->width | bitmap->height) & ((1 << lod) - 1)))
+    {
+        lod--;
+    }
+    
+    int width; int height;
+    const uint8_t *data = bitmapMipData(bitmap, lod, &width, &height);
+    int columns = (lod == 0 && bitmap->layout == kMode7BitmapLayoutTiled) ? bitmap->blockColumns : 0;
+    
+    if((width & (width - 1)) == 0 && (height & (height - 1)) == 0)
+    {
+        // Power of two, wrap with masks
+        // A mirrored period is twice the size, its second half is flipped
+        int mirrored = (addressMode == kMode7AddressModeMirroredRepeat);
+        int logX = log2_int(width);
+        int logY = log2_int(height);
+        int maskX = (width << mirrored) - 1;
+        int maskY = (height << mirrored) - 1;
+        
+        for(int i = 0; i < row->length; i++)
+        {
+            int x; int y;
+            rowMapAt(row, i, &x, &y);
+            x = (x >> lod) & maskX;
+            y = (y >> lod) & maskY;
+            x ^= -((x >> logX) & 1) & maskX;
+            y ^= -((y >> logY) & 1) & maskY;
+            colors[i] = data[columns ? blockOffset(x, y, columns) : y * width + x];
+        }
+    }
+    else
+    {
+        for(int i = 0; i < row->length; i++)
+        {
+            int x; int y;
+            rowMapAt(row, i, &x, &y);
+            x = wrapCoordinate(x >> lod, width, addressMode);
+            y = wrapCoordinate(y >> lod, height, addressMode);
+            colors[i] = data[columns ? blockOffset(x, y, columns) : y * width + x];
+        }
+    }
+}
+
+#if PD_MODE7_TILEMAP
+static inline void sampleTilemapRow(PDMode7_Plane *plane, _PDMode7_RowSetup *row, int rowLod, int start, int end, uint8_t *colors)
+{
+    // Samples are within the world bounds
+    PDMode7_Tilemap *tilemap = plane->tilemap;
+    for(int i = start; i < end; i++)
+    {
+        int x; int y;
+        rowMapAt(row, i, &x, &y);
+        
+        PDMode7_Tile *tile = &tilemap->tiles[(y >> tilemap->tileHeight_log) * tilemap->columns + (x >> tilemap->tileWidth_log)];
+        PDMode7_Bitmap *bitmap = tile->bitmap;
+        if(bitmap)
+        {
+            // Level is picked per tile, a scaled tile covers fewer texels
+            int lod = mode7_max(0, mode7_min(rowLod - tile->scale_log, bitmap->mipLevels));
+            int tileX = (x & (tilemap->tileWidth - 1)) >> (tile->scale_log + lod);
+            int tileY = (y & (tilemap->tileHeight - 1)) >> (tile->scale_log + lod);
+            colors[i] = bitmapMipTexel(bitmap, lod, tileX, tileY);
+        }
+        else
+        {
+            colors[i] = plane->fillColor.gray;
+        }
+    }
+}
+
+static inline void sampleTilemapFillRow(PDMode7_Tilemap *tilemap, _PDMode7_RowSetup *row, int rowLod, int start, int end, uint8_t *colors)
+{
+    PDMode7_Bitmap *fillBitmap = tilemap->fillBitmap;
+    int lod = mode7_max(0, mode7_min(rowLod - tilemap->fillBitmapScale_log, fillBitmap->mipLevels));
+    int shift = tilemap->fillBitmapScale_log + lod;
+    for(int i = start; i < end; i++)
+    {
+        int x; int y;
+        rowMapAt(row, i, &x, &y);
+        
+        int tileX = (x & (tilemap->tileWidth - 1)) >> shift;
+        int tileY = (y & (tilemap->tileHeight - 1)) >> shift;
+        colors[i] = bitmapMipTexel(fillBitmap, lod, tileX, tileY);
+    }
+}
+#endif
+
+static inline void samplePlaneRowKernel(PDMode7_World *world, PDMode7_Plane *plane, PDMode7_Shader *shader, _PDMode7_RowSetup *row, uint8_t *colors, _PDMode7_RowSpan *span, _PDMode7_Parameters *parameters, const int hasShader)
+{
+    int start = 0;
+    int end = 0;
+    uint8_t fillColor = plane->fillColor.gray;
+    int rowLod = rowMipLevel(row);
+    
+#if PD_MODE7_TILEMAP
+    if(plane->tilemap)
+    {
+        rowClipToBounds(row, world->width, world->height, &start, &end);
+        sampleTilemapRow(plane, row, rowLod, start, end, colors);
+        
+        if(plane->tilemap->fillBitmap && row->finite)
+        {
+            // The fill bitmap is repeated outside of the world
+            sampleTilemapFillRow(plane->tilemap, row, rowLod, 0, start, colors);
+            sampleTilemapFillRow(plane->tilemap, row, rowLod, end, row->length, colors);
+            start = 0;
+            end = row->length;
+        }
+    }
+    else
+#endif
+    if(plane->bitmap)
+    {
+        if(plane->addressMode == kMode7AddressModeFill)
+        {
+            rowClipToBounds(row, plane->bitmap->width, plane->bitmap->height, &start, &end);
+            sampleBitmapRow(plane->bitmap, row, mode7_min(rowLod, plane->bitmap->mipLevels), start, end, colors);
+        }
+        else if(row->finite && plane->bitmap->width > 0 && plane->bitmap->height > 0)
+        {
+            // Repeated bitmaps cover the whole row
+            sampleBitmapRowWrapped(plane->bitmap, plane->addressMode, row, mode7_min(rowLod, plane->bitmap->mipLevels), colors);
+            start = 0;
+            end = row->length;
+        }
+    }
+    
+#if PD_MODE7_SHADER
+    if(hasShader && shader)
+    {
+        if(shader->objectType == PDMode7_ShaderTypeRadial && (start > 0 || end < row->length))
+        {
+            // Radial shading changes along the row, the fill isn't uniform
+            memset(colors, fillColor, start);
+            memset(colors + end, fillColor, row->length - end);
+            start = 0;
+            end = row->length;
+        }
+        for(int i = start; i < end; i++)
+        {
+            shaderApply(shader, colors + i, rowPointAt(row, i), parameters);
+        }
+        shaderApply(shader, &fillColor, row->leftPoint, parameters);
+    }
+#endif
+    
+    span->start = start;
+    span->end = end;
+    span->fillColor = fillColor;
+}
+
+// Row samplers specialized for shader
+#define MODE7_ROW_SAMPLER(name, shader) \
+static void name(PDMode7_World *world, PDMode7_Plane *plane, PDMode7_Shader *planeShader, _PDMode7_RowSetup *row, uint8_t *colors, _PDMode7_RowSpan *span, _PDMode7_Parameters *parameters) \
+{ \
+    samplePlaneRowKernel(world, plane, planeShader, row, colors, span, parameters, shader); \
+}
+
+MODE7_ROW_SAMPLER(samplePlaneRow, 0)
+MODE7_ROW_SAMPLER(samplePlaneRowShader, 1)
+
+// [shader]
+static _PDMode7_RowSampler* const rowSamplers[2] = {
+    samplePlaneRow, samplePlaneRowShader
+};
+
+static void samplePlaneRowFar(PDMode7_World *world, PDMode7_Plane *plane, PDMode7_Shader *shader, _PDMode7_RowSetup *row, uint8_t *colors, _PDMode7_RowSpan *span, _PDMode7_Parameters *parameters)
+{
+    // Rows beyond the far distance are not sampled, they're filled like the out-of-bounds space
+    uint8_t fillColor = plane->fillColor.gray;
+#if PD_MODE7_SHADER
+    shaderApply(shader, &fillColor, row->leftPoint, parameters);
+#endif
+    span->start = 0;
+    span->end = 0;
+    span->fillColor = fillColor;
+}
+
+static const uint8_t* getDitherTable(int ditherType)
+{
+    uint8_t *table = ditherTables[ditherType];
+    if(!table)
+    {
+        _PDMode7_DitherPattern p = patterns[ditherType];
+        int phases = p.mod + 1;
+        table = playdate->system->realloc(NULL, phases * 256);
+        for(int phase = 0; phase < phases; phase++)
+        {
+            for(int gray = 0; gray < 256; gray++)
+            {
+                uint8_t patternIndex = (gray * p.len) >> 8;
+                table[phase * 256 + gray] = p.data[(patternIndex << p.mul) + phase];
+            }
+        }
+        ditherTables[ditherType] = table;
+    }
+    return table;
+}
+
+static void rowSpanToBytes(_PDMode7_RowSpan *span, uint8_t *colors, int samplesPerByte)
+{
+    if(span->start >= span->end)
+    {
+        span->start = 0;
+        span->end = 0;
+        return;
+    }
+    
+    // Bytes shared between the span and the fill are packed, pad them with the fill color
+    int byteStart = span->start / samplesPerByte;
+    int byteEnd = (span->end + samplesPerByte - 1) / samplesPerByte;
+    
+    memset(colors + byteStart * samplesPerByte, span->fillColor, span->start - byteStart * samplesPerByte);
+    memset(colors + span->end, span->fillColor, byteEnd * samplesPerByte - span->end);
+    
+    span->start = byteStart;
+    span->end = byteEnd;
+}
+
+static inline uint8_t packRowByte(const uint8_t **colors, const int xStep, const uint8_t *ditherTable)
+{
+    // Each sample covers xStep bits, a byte is resolved at once
+    const uint8_t *ptr = *colors;
+    uint8_t byte = 0;
+    for(int bit = 0; bit < 8; bit += xStep)
+    {
+        uint8_t mask = (uint8_t)(0xFF00 >> xStep) >> bit;
+        byte |= ditherTable[*ptr++] & mask;
+    }
+    *colors = ptr;
+    return byte;
+}
+
+static inline void packRowBytes(uint8_t *ptr, const uint8_t *colors, int length, const uint8_t *ditherTable, const int xStep)
+{
+    uint8_t *end = ptr + length;
+    
+    // Write bytes until the pointer is word-aligned
+    while(ptr < end && ((uintptr_t)ptr & 3))
+    {
+        *ptr++ = packRowByte(&colors, xStep, ditherTable);
+    }
+    
+    // Compose 32 pixels and store them as a word
+    // The framebuffer is a byte stream, the first byte must land at the lowest address
+    while((end - ptr) >= 4)
+    {
+        uint32_t b0 = packRowByte(&colors, xStep, ditherTable);
+        uint32_t b1 = packRowByte(&colors, xStep, ditherTable);
+        uint32_t b2 = packRowByte(&colors, xStep, ditherTable);
+        uint32_t b3 = packRowByte(&colors, xStep, ditherTable);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+        uint32_t word = (b0 << 24) | (b1 << 16) | (b2 << 8) | b3;
+#else
+        uint32_t word = b0 | (b1 << 8) | (b2 << 16) | (b3 << 24);
+#endif
+        memcpy(ptr, &word, 4);
+        ptr += 4;
+    }
+    
+    // Remaining bytes
+    while(ptr < end)
+    {
+        *ptr++ = packRowByte(&colors, xStep, ditherTable);
+    }
+}
+
+static inline void drawRowKernel(uint8_t *ptr, const uint8_t *colors, int width, const uint8_t *ditherTable, _PDMode7_RowSpan *span, const int xStep)
+{
+    // Span is in bytes, bytes outside of it are filled in bulk
+    const int samplesPerByte = 8 / xStep;
+    uint8_t fillByte = ditherTable[span->fillColor];
+    
+    int length = width / 8;
+    int start = mode7_min(span->start, length);
+    int end = mode7_min(span->end, length);
+    
+    memset(ptr, fillByte, start);
+    packRowBytes(ptr + start, colors + start * samplesPerByte, end - start, ditherTable, xStep);
+    memset(ptr + end, fillByte, length - end);
+    
+    int remainder = width & 7;
+    if(remainder > 0)
+    {
+        // Partial byte at the end of the row
+        uint8_t spanMask = (uint8_t)(0xFF00 >> remainder);
+        uint8_t byte = fillByte;
+        if(length >= span->start && length < span->end)
+        {
+            const uint8_t *tail = colors + length * samplesPerByte;
+            byte = packRowByte(&tail, xStep, ditherTable);
+        }
+        ptr[length] = (ptr[length] & ~spanMask) | (byte & spanMask);
+    }
+}
+
+// Row writers specialized for horizontal step
+#define MODE7_ROW_WRITER(name, xStep) \
+static void name(uint8_t *ptr, const uint8_t *colors, int width, const uint8_t *ditherTable, _PDMode7_RowSpan *span) \
+{ \
+    drawRowKernel(ptr, colors, width, ditherTable, span, xStep); \
+}
+
+MODE7_ROW_WRITER(drawRow1x, 1)
+MODE7_ROW_WRITER(drawRow2x, 2)
+MODE7_ROW_WRITER(drawRow4x, 4)
+
+// [PDMode7_DisplayScale]
+// Two-row scales write the second row with the same kernel
+static _PDMode7_RowWriter* const rowWriters[5] = {
+    drawRow1x, drawRow2x, drawRow2x, drawRow4x, drawRow4x
+};
+
+// Indexed by log2 of the horizontal step
+static _PDMode7_RowWriter* const stepWriters[3] = {
+    drawRow1x, drawRow2x, drawRow4x
+};
+
+static void rowTableBuild(_PDMode7_RowTable *table, PDMode7_Display *display, _PDMode7_Parameters *p, int xStep, int yStep)
+{
+    PDMode7_Vec3 position = display->camera->position;
+    
+    // Pre-calculate displayWidth
+    float displayWidthInv = 1.0f / display->rect.width * xStep;
+    
+    // Number of samples per row
+    int rowLength = (display->rect.width + xStep - 1) / xStep;
+    
+    // Screen x of the scanline endpoints, same for every row
+    float leftScreenX = (0 * p->screenRatio.x - 1) * p->tanHalfFov.x;
+    float rightScreenX = (display->rect.width * p->screenRatio.x - 1) * p->tanHalfFov.x;
+    
+    for(int y = 0; y < p->planeHeight; y += yStep)
+    {
+        int relativeY = p->horizon + y;
+        
+        float y_ndc = 1 - relativeY * p->screenRatio.y;
+        int onHorizon = (y_ndc == 0);
+        if(onHorizon)
+        {
+            y_ndc = -(p->ndc_inf);
+        }
+        float worldScreenY = y_ndc * p->tanHalfFov.y;
+        
+        // Endpoints share the same direction z, one divide per row
+        float directionZ = p->forwardVec.z + p->rightVec.z * leftScreenX + p->upVec.z * worldScreenY;
+        
+        PDMode7_Vec3 leftPoint = newVec3(0, 0, -1);
+        PDMode7_Vec3 rightPoint = newVec3(0, 0, -1);
+        float distance = INFINITY;
+        
+        if(directionZ < 0)
+        {
+            float t = -(position.z) / directionZ;
+            
+            leftPoint.x = position.x + t * (p->forwardVec.x + p->rightVec.x * leftScreenX + p->upVec.x * worldScreenY);
+            leftPoint.y = position.y + t * (p->forwardVec.y + p->rightVec.y * leftScreenX + p->upVec.y * worldScreenY);
+            leftPoint.z = 0;
+            
+            rightPoint.x = position.x + t * (p->forwardVec.x + p->rightVec.x * rightScreenX + p->upVec.x * worldScreenY);
+            rightPoint.y = position.y + t * (p->forwardVec.y + p->rightVec.y * rightScreenX + p->upVec.y * worldScreenY);
+            rightPoint.z = 0;
+            
+            distance = t;
+        }
+        
+        if(onHorizon)
+        {
+            // The horizon row is moved for the intersection, not for the distance
+            distance = distanceAtScanline(relativeY, display, p);
+        }
+        
+        leftPoint.x *= p->worldScaleInv;
+        leftPoint.y *= p->worldScaleInv;
+        rightPoint.x *= p->worldScaleInv;
+        rightPoint.y *= p->worldScaleInv;
+        
+        // Calculate the delta between the scanline points
+        // Then divide it by the display width
+        float dxStep = (rightPoint.x - leftPoint.x) * displayWidthInv;
+        float dyStep = (rightPoint.y - leftPoint.y) * displayWidthInv;
+        
+        _PDMode7_RowTableEntry *entry = &table->rows[y];
+        rowSetupInit(&entry->row, leftPoint, rightPoint, dxStep, dyStep, rowLength);
+        entry->distance = distance;
+    }
+}
+
+static _PDMode7_RowTableEntry* displayGetRowTable(PDMode7_Display *display, _PDMode7_Parameters *p, int xStep, int yStep)
+{
+    _PDMode7_RowTable *table = display->rowTable;
+    
+    _PDMode7_RowTableKey key;
+    memset(&key, 0, sizeof(_PDMode7_RowTableKey));
+    key.parameters = *p;
+    key.position = display->camera->position;
+    key.width = display->rect.width;
+    key.xStep = xStep;
+    key.yStep = yStep;
+    
+    // Rows are recomputed only when the camera or the rect change
+    if(table->valid && memcmp(&key, &table->key, sizeof(_PDMode7_RowTableKey)) == 0)
+    {
+        return table->rows;
+    }
+    
+    if(p->planeHeight > table->capacity)
+    {
+        table->capacity = p->planeHeight;
+        table->rows = playdate->system->realloc(table->rows, table->capacity * sizeof(_PDMode7_RowTableEntry));
+    }
+    
+    rowTableBuild(table, display, p, xStep, yStep);
+    
+    table->key = key;
+    table->valid = 1;
+    
+    return table->rows;
+}
+
+static void displayTemporalBegin(PDMode7_Display *display, _PDMode7_Parameters *p)
+{
+    _PDMode7_Temporal *temporal = &display->temporal;
+    PDMode7_Camera *camera = display->camera;
+    
+    int partial = 0;
+    if(temporal->mode != kMode7DisplayRenderModeFull && temporal->valid && temporal->camera == camera && temporal->scale == display->scale && temporal->horizon == p->horizon && temporal->planeHeight == p->planeHeight && temporal->fov == camera->fov && temporal->farDistance == camera->farDistance)
+    {
+        float dx = camera->position.x - temporal->position.x;
+        float dy = camera->position.y - temporal->position.y;
+        float dz = camera->position.z - temporal->position.z;
+        float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+        float angle = fabsf(remainderf(camera->angle - temporal->angle, 2 * (float)M_PI));
+        float pitch = fabsf(camera->pitch - temporal->pitch);
+        
+        // Previous rows are kept only if the camera moved less than the threshold
+        partial = (distance <= temporal->refreshDistance && angle <= temporal->refreshAngle && pitch <= temporal->refreshAngle);
+    }
+    
+    temporal->partial = partial;
+    temporal->valid = (temporal->mode != kMode7DisplayRenderModeFull);
+    temporal->frame++;
+    temporal->camera = camera;
+    temporal->position = camera->position;
+    temporal->angle = camera->angle;
+    temporal->pitch = camera->pitch;
+    temporal->fov = camera->fov;
+    temporal->farDistance = camera->farDistance;
+    temporal->horizon = p->horizon;
+    temporal->planeHeight = p->planeHeight;
+    temporal->scale = display->scale;
+}
+
+static void displayUpdateSpriteRows(PDMode7_Display *display)
+{
+    // Rows covered by sprites must be redrawn in the next frame
+    int height = mode7_max(display->rect.height, 0);
+    memset(display->spriteRows, 0, height);
+    
+    for(int i = 0; i < display->visibleInstances->length; i++)
+    {
+        PDMode7_SpriteInstance *instance = display->visibleInstances->items[i];
+        int y0 = mode7_max(instance->displayRect.y - display->rect.y, 0);
+        int y1 = mode7_min(instance->displayRect.y + instance->displayRect.height - display->rect.y, height);
+        if(y1 > y0)
+        {
+            memset(display->spriteRows + y0, 1, y1 - y0);
+        }
+    }
+}
+
+static inline int displayTemporalRowMode(PDMode7_Display *display, int mode, int relativeY, int count)
+{
+    if(mode != kMode7DisplayRenderModeFull)
+    {
+        int y0 = mode7_max(relativeY, 0);
+        int y1 = mode7_min(relativeY + count, display->rect.height);
+        for(int y = y0; y < y1; y++)
+        {
+            if(display->spriteRows[y])
+            {
+                return kMode7DisplayRenderModeFull;
+            }
+        }
+    }
+    return mode;
+}
+
+static void rowSetupStride(_PDMode7_RowSetup *row, int phase, int stride, _PDMode7_RowSetup *strideRow)
+{
+    // One sample every stride, starting from phase
+    int length = (row->length - phase + stride - 1) / stride;
+    PDMode7_Vec3 leftPoint = rowPointAt(row, phase);
+    PDMode7_Vec3 rightPoint = rowPointAt(row, phase + length * stride);
+    rowSetupInit(strideRow, leftPoint, rightPoint, row->dxStep * stride, row->dyStep * stride, length);
+}
+
+static inline int displayRowXStep(PDMode7_Display *display, int xStep, float distance)
+{
+    // Distant rows are sampled at a coarser step, never finer than the display scale
+    int rowXStep = xStep;
+    if(display->adaptiveDistance4x > 0 && distance > display->adaptiveDistance4x)
+    {
+        rowXStep = 4;
+    }
+    else if(display->adaptiveDistance2x > 0 && distance > display->adaptiveDistance2x)
+    {
+        rowXStep = 2;
+    }
+    return mode7_max(rowXStep, xStep);
+}
+
+static inline void drawRowMasked(_PDMode7_RowWriter *drawRow, uint8_t *ptr, uint8_t *lineBuffer, const uint8_t *colors, int width, const uint8_t *ditherTable, _PDMode7_RowSpan *span, uint8_t mask)
+{
+    drawRow(lineBuffer, colors, width, ditherTable, span);
+    
+    // Only the masked columns are replaced, the others are kept from the previous frame
+    int length = width / 8;
+    for(int i = 0; i < length; i++)
+    {
+        ptr[i] = (ptr[i] & ~mask) | (lineBuffer[i] & mask);
+    }
+    
+    int remainder = width & 7;
+    if(remainder > 0)
+    {
+        uint8_t tailMask = mask & (uint8_t)(0xFF00 >> remainder);
+        ptr[length] = (ptr[length] & ~tailMask) | (lineBuffer[length] & tailMask);
+    }
+}
+
+static inline uint8_t reverseByte(uint8_t byte)
+{
+    byte = (uint8_t)((byte & 0xF0) >> 4 | (byte & 0x0F) << 4);
+    byte = (uint8_t)((byte & 0xCC) >> 2 | (byte & 0x33) << 2);
+    byte = (uint8_t)((byte & 0xAA) >> 1 | (byte & 0x55) << 1);
+    return byte;
+}
+
+static void displayWriteLine(PDMode7_Display *display, uint8_t *framebuffer, int rowbytes, int y, const uint8_t *line, uint8_t mask)
+{
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    int width = display->rect.width;
+    
+    if(t->xy == 0)
+    {
+        int frameY = t->y + y * t->yy;
+        if(frameY < 0 || frameY >= t->height)
+        {
+            return;
+        }
+        
+        // Mirrored row, bytes are written in reverse order
+        int length = width / 8;
+        int startByte = (t->x - (display->rect.x + width - 1)) / 8;
+        int start = mode7_max(-startByte, 0);
+        int end = mode7_min(length, t->width / 8 - startByte);
+        
+        uint8_t *ptr = framebuffer + frameY * rowbytes + startByte;
+        uint8_t reversedMask = reverseByte(mask);
+        for(int i = start; i < end; i++)
+        {
+            uint8_t byte = reverseByte(line[length - 1 - i]);
+            ptr[i] = (ptr[i] & ~reversedMask) | (byte & reversedMask);
+        }
+    }
+    else
+    {
+        int frameX = t->x + y * t->yx;
+        if(frameX < 0 || frameX >= t->width)
+        {
+            return;
+        }
+        
+        // Rotated row, each pixel is a bit in a framebuffer column
+        int frameY = t->y + display->rect.x * t->xy;
+        int start = (t->xy > 0) ? -frameY : (frameY - t->height + 1);
+        int end = (t->xy > 0) ? (t->height - frameY) : (frameY + 1);
+        start = mode7_max(start, 0);
+        end = mode7_min(end, width);
+        
+        uint8_t bit = 0x80 >> (frameX & 7);
+        int stride = t->xy * rowbytes;
+        uint8_t *ptr = framebuffer + (frameY + start * t->xy) * rowbytes + frameX / 8;
+        for(int i = start; i < end; i++)
+        {
+            uint8_t pixel = 0x80 >> (i & 7);
+            if(mask & pixel)
+            {
+                *ptr = (line[i >> 3] & pixel) ? (*ptr | bit) : (*ptr & ~bit);
+            }
+            ptr += stride;
+        }
+    }
+}
+
+static inline void drawPlaneRow(PDMode7_Display *display, uint8_t *framebuffer, int rowbytes, int y, _PDMode7_RowWriter *drawRow, const uint8_t *colors, const uint8_t *ditherTable, _PDMode7_RowSpan *span, uint8_t mask)
+{
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    uint8_t *lineBuffer = display->lineBuffer;
+    
+    if(t->xx == 1)
+    {
+        // Display rows are framebuffer rows
+        int frameY = t->y + y * t->yy;
+        if(frameY < 0 || frameY >= t->height)
+        {
+            return;
+        }
+        
+        uint8_t *ptr = framebuffer + frameY * rowbytes + (t->x + display->rect.x) / 8;
+        if(mask == 0xFF)
+        {
+            drawRow(ptr, colors, display->rect.width, ditherTable, span);
+        }
+        else
+        {
+            drawRowMasked(drawRow, ptr, lineBuffer, colors, display->rect.width, ditherTable, span, mask);
+        }
+    }
+    else
+    {
+        drawRow(lineBuffer, colors, display->rect.width, ditherTable, span);
+        displayWriteLine(display, framebuffer, rowbytes, y, lineBuffer, mask);
+    }
+}
+
+static void drawPlane(PDMode7_World *world, PDMode7_Display *display, _PDMode7_Parameters *parameters, const uint8_t *dirtyRows)
+{
+    LCDBitmap *target; uint8_t *framebuffer; int rowbytes;
+    displayGetFramebuffer(display, &target, &framebuffer, &rowbytes);
+    
+    int xStep; int yStep;
+    getDisplayScaleStep(display->scale, &xStep, &yStep);
+    
+    _PDMode7_RowTableEntry *rows = displayGetRowTable(display, parameters, xStep, yStep);
+    
+    uint8_t *planeColors = display->rowColors;
+#if PD_MODE7_CEILING
+    // Ceiling samples follow the plane samples
+    int rowLength = (display->rect.width + xStep - 1) / xStep;
+    uint8_t *ceilingColors = display->rowColors + rowLength + 8;
+    int hasCeiling = (world->ceiling.bitmap || world->ceiling.tilemap);
+#endif
+    
+    // Kernels are chosen once per frame
+    int ditherType = (display->ditherType >= 0 && display->ditherType < 3) ? display->ditherType : 0;
+    int scaleIndex = (display->scale >= 0 && display->scale < 5) ? display->scale : 0;
+    _PDMode7_RowWriter *drawRow = rowWriters[scaleIndex];
+    
+    // Dither tables are indexed by row phase
+    const uint8_t *ditherTable = getDitherTable(ditherType);
+    int ditherMod = patterns[ditherType].mod;
+    
+    int hasShader = 0;
+#if PD_MODE7_SHADER
+    hasShader = (display->planeShader || display->ceilingShader);
+#endif
+    _PDMode7_RowSampler *sampleRow = rowSamplers[hasShader];
+    
+    // Temporal modes redraw a subset of the plane, the rest is kept from the previous frame
+    // Dirty rows are drawn in full over the cached frame
+    int temporalMode = (display->temporal.partial && !dirtyRows) ? display->temporal.mode : kMode7DisplayRenderModeFull;
+    
+    // Rows are marked one by one if the plane is not entirely drawn
+    // Rotated rows cover every framebuffer row, they're marked once
+    int markRows = ((temporalMode != kMode7DisplayRenderModeFull || dirtyRows) && display->frameTransform.xy == 0);
+    
+    for(int y = 0; y < parameters->planeHeight; y += yStep)
+    {
+        int relativeY = parameters->horizon + y;
+        int absoluteY = display->rect.y + relativeY;
+        
+        _PDMode7_RowTableEntry *entry = &rows[y];
+        _PDMode7_RowSampler *rowSampler = cameraIsBeyondFarDistance(display->camera, entry->distance) ? samplePlaneRowFar : sampleRow;
+        
+        // Rows in a band share the horizontal step and its writer
+        int rowXStep = displayRowXStep(display, xStep, entry->distance);
+        int rowSamplesPerByte = 8 / rowXStep;
+        _PDMode7_RowWriter *drawBandRow = (rowXStep == xStep) ? drawRow : stepWriters[rowXStep >> 1];
+        _PDMode7_RowSetup *row = &entry->row;
+        _PDMode7_RowSetup bandRow;
+        if(rowXStep != xStep)
+        {
+            rowSetupStride(&entry->row, 0, rowXStep / xStep, &bandRow);
+            row = &bandRow;
+        }
+        
+        // Phase alternates by row and by frame
+        int rowPhase = ((y / yStep) + display->temporal.frame) & 1;
+        int rowMode = temporalMode;
+        if(rowMode == kMode7DisplayRenderModeCheckerboard && rowXStep > 2)
+        {
+            rowMode = kMode7DisplayRenderModeInterlaced;
+        }
+        
+        // Checkerboard rows are written at twice the step, then merged by column
+        _PDMode7_RowWriter *drawHalfRow = NULL;
+        uint8_t rowMask = 0;
+        _PDMode7_RowSetup halfRow;
+        if(rowMode == kMode7DisplayRenderModeCheckerboard)
+        {
+            // Half rows are written at twice the step, checkerboard is limited to steps 1 and 2
+            drawHalfRow = stepWriters[(rowXStep == 1) ? 1 : 2];
+            uint8_t halfMask = (rowXStep == 1) ? 0xAA : 0xCC;
+            rowMask = rowPhase ? ~halfMask : halfMask;
+            rowSetupStride(row, rowPhase, 2, &halfRow);
+        }
+        
+#if PD_MODE7_SHADER
+        shaderPrepareRow(display->planeShader, entry->distance, parameters);
+#if PD_MODE7_CEILING
+        shaderPrepareRow(display->ceilingShader, entry->distance, parameters);
+#endif
+#endif
+        _PDMode7_RowSpan span;
+        
+        int planeRows = (yStep > 1 && (relativeY + yStep) <= display->rect.height) ? 2 : 1;
+        int planeMode = displayTemporalRowMode(display, rowMode, relativeY, planeRows);
+        
+        if(dirtyRows && !(dirtyRows[y / yStep] & 1))
+        {
+            planeRows = 0;
+        }
+        else if(planeMode == kMode7DisplayRenderModeCheckerboard)
+        {
+            rowSampler(world, &world->plane, display->planeShader, &halfRow, planeColors, &span, parameters);
+            rowSpanToBytes(&span, planeColors, rowSamplesPerByte / 2);
+            
+            drawPlaneRow(display, framebuffer, rowbytes, absoluteY, drawHalfRow, planeColors, ditherTable + (absoluteY & ditherMod) * 256, &span, rowMask);
+            if(planeRows > 1)
+            {
+                drawPlaneRow(display, framebuffer, rowbytes, absoluteY + 1, drawHalfRow, planeColors, ditherTable + ((absoluteY + 1) & ditherMod) * 256, &span, rowMask);
+            }
+        }
+        else if(planeMode == kMode7DisplayRenderModeFull || !rowPhase)
+        {
+            rowSampler(world, &world->plane, display->planeShader, row, planeColors, &span, parameters);
+            rowSpanToBytes(&span, planeColors, rowSamplesPerByte);
+            
+            drawPlaneRow(display, framebuffer, rowbytes, absoluteY, drawBandRow, planeColors, ditherTable + (absoluteY & ditherMod) * 256, &span, 0xFF);
+            
+            // If y exceeds display height, draw a single row
+            if(planeRows > 1)
+            {
+                drawPlaneRow(display, framebuffer, rowbytes, absoluteY + 1, drawBandRow, planeColors, ditherTable + ((absoluteY + 1) & ditherMod) * 256, &span, 0xFF);
+            }
+        }
+        else
+        {
+            planeRows = 0;
+        }
+        
+        if(!target && markRows && planeRows > 0)
+        {
+            displayMarkRows(display, absoluteY, absoluteY + planeRows - 1);
+        }
+        
+#if PD_MODE7_CEILING
+        int ceilingRelativeY = parameters->horizon - y;
+        if(hasCeiling && ceilingRelativeY > 0)
+        {
+            int ceilingRows = (yStep > 1 && (ceilingRelativeY - yStep) >= 0) ? 2 : 1;
+            int ceilingMode = displayTemporalRowMode(display, rowMode, ceilingRelativeY - ceilingRows, ceilingRows);
+            
+            // Ceiling is mirrored above the horizon
+            int ceilingY = display->rect.y + ceilingRelativeY - 1;
+            if(dirtyRows && !(dirtyRows[y / yStep] & 2))
+            {
+                ceilingRows = 0;
+            }
+            else if(ceilingMode == kMode7DisplayRenderModeCheckerboard)
+            {
+                rowSampler(world, &world->ceiling, display->ceilingShader, &halfRow, ceilingColors, &span, parameters);
+                rowSpanToBytes(&span, ceilingColors, rowSamplesPerByte / 2);
+                
+                drawPlaneRow(display, framebuffer, rowbytes, ceilingY, drawHalfRow, ceilingColors, ditherTable + ((absoluteY - 1) & ditherMod) * 256, &span, rowMask);
+                if(ceilingRows > 1)
+                {
+                    drawPlaneRow(display, framebuffer, rowbytes, ceilingY - 1, drawHalfRow, ceilingColors, ditherTable + ((absoluteY - 2) & ditherMod) * 256, &span, rowMask);
+                }
+            }
+            else if(ceilingMode == kMode7DisplayRenderModeFull || !rowPhase)
+            {
+                rowSampler(world, &world->ceiling, display->ceilingShader, row, ceilingColors, &span, parameters);
+                rowSpanToBytes(&span, ceilingColors, rowSamplesPerByte);
+                
+                drawPlaneRow(display, framebuffer, rowbytes, ceilingY, drawBandRow, ceilingColors, ditherTable + ((absoluteY - 1) & ditherMod) * 256, &span, 0xFF);
+                
+                if(ceilingRows > 1)
+                {
+                    drawPlaneRow(display, framebuffer, rowbytes, ceilingY - 1, drawBandRow, ceilingColors, ditherTable + ((absoluteY - 2) & ditherMod) * 256, &span, 0xFF);
+                }
+            }
+            else
+            {
+                ceilingRows = 0;
+            }
+            
+            if(!target && markRows && ceilingRows > 0)
+            {
+                displayMarkRows(display, ceilingY - ceilingRows + 1, ceilingY);
+            }
+        }
+#endif
+    }
+    
+    if(!target && !markRows)
+    {
+        int absoluteHorizon = display->rect.y + parameters->horizon;
+        int startY = absoluteHorizon;
+#if PD_MODE7_CEILING
+        startY = mode7_max(absoluteHorizon - parameters->planeHeight, 0);
+#endif
+        displayMarkRows(display, startY, absoluteHorizon + parameters->planeHeight - 1);
+    }
+}
+
+// Display whose sprites are being drawn, sprite callbacks receive only the instance
+static PDMode7_Display *spriteDrawDisplay = NULL;
+
+static void drawSprite(PDMode7_SpriteInstance *instance)
+{
+    if(instance->bitmap && spriteDrawDisplay)
+    {
+        displayDrawBitmap(spriteDrawDisplay, instance->bitmap, instance->displayRect.x, instance->displayRect.y);
+    }
+}
+
+static void drawSprites(PDMode7_Display *display)
+{
+    spriteDrawDisplay = display;
+    
+    for(int i = 0; i < display->visibleInstances->length; i++)
+    {
+        PDMode7_SpriteInstance *instance = display->visibleInstances->items[i];
+        
+        if(instance->drawCallback)
+        {
+            switch(instance->drawCallback->type)
+            {
+                case _PDMode7_CallbackTypeC:
+                {
+                    PDMode7_SpriteDrawCallbackFunction *drawFunction = instance->drawCallback->cFunction;
+                    drawFunction(instance, instance->bitmap, instance->displayRect, drawSprite);
+                    break;
+                }
+                case _PDMode7_CallbackTypeLua:
+                {
+                    lua_spriteCallDrawCallback(instance);
+                    break;
+                }
+            }
+        }
+        else
+        {
+            drawSprite(instance);
+        }
+    }
+    
+    spriteDrawDisplay = NULL;
+}
+
+static unsigned int planeTilemapVersion(PDMode7_Plane *plane)
+{
+    // Tiles can be any bitmap, a tilemap follows the changes of every bitmap
+    return plane->tilemap ? (plane->tilemap->version + bitmapVersion) : 0;
+}
+
+static _PDMode7_FrameKey displayFrameKey(PDMode7_World *world, PDMode7_Display *display)
+{
+    _PDMode7_FrameKey key;
+    memset(&key, 0, sizeof(_PDMode7_FrameKey));
+    key.world = world;
+    key.camera = display->camera;
+    key.cameraVersion = display->camera->version;
+    key.worldVersion = world->version;
+    key.planeShaderVersion = display->planeShader ? display->planeShader->version : 0;
+    key.ceilingShaderVersion = display->ceilingShader ? display->ceilingShader->version : 0;
+    key.tilemapVersion = planeTilemapVersion(&world->plane) + planeTilemapVersion(&world->ceiling);
+    key.planeVersion = world->plane.bitmap ? world->plane.bitmap->version : 0;
+    key.ceilingVersion = world->ceiling.bitmap ? world->ceiling.bitmap->version : 0;
+    return key;
+}
+
+static void displayFrameCacheRows(PDMode7_World *world, PDMode7_Display *display, _PDMode7_Parameters *p, int *startRow, int *endRow)
+{
+    if(display->drawsToSecondary || displayIsTransformed(display))
+    {
+        // The whole rect is cleared and drawn by the display
+        *startRow = 0;
+        *endRow = display->rect.height;
+        return;
+    }
+    
+    // Rows above the plane may be drawn by the game, only the plane and the ceiling are kept
+    *startRow = p->horizon;
+#if PD_MODE7_CEILING
+    if(world->ceiling.bitmap || world->ceiling.tilemap)
+    {
+        *startRow = mode7_max(p->horizon - p->planeHeight, 0);
+    }
+#endif
+    *endRow = p->horizon + p->planeHeight;
+}
+
+static void displayFrameCacheCopy(PDMode7_Display *display, uint8_t *cache, int restore, int startRow, int endRow)
+{
+    LCDBitmap *target; uint8_t *framebuffer; int rowbytes;
+    displayGetFramebuffer(display, &target, &framebuffer, &rowbytes);
+    
+    _PDMode7_FrameSpan span = displayFrameSpan(display);
+    int length = span.length;
+    
+    // A subset of rows is only kept for untransformed displays, display rows are framebuffer rows
+    int startY = span.startY;
+    int endY = span.endY;
+    if(startRow > 0 || endRow < display->rect.height)
+    {
+        startY = mode7_max(startY, display->rect.y + startRow);
+        endY = mode7_min(endY, display->rect.y + endRow);
+    }
+    
+    for(int y = startY; y < endY; y++)
+    {
+        uint8_t *frameRow = framebuffer + y * rowbytes + span.startByte;
+        uint8_t *cacheRow = cache + (y - span.startY) * length;
+        if(restore)
+        {
+            uint8_t left = frameRow[0];
+            uint8_t right = frameRow[length - 1];
+            memcpy(frameRow, cacheRow, length);
+            frameRow[length - 1] = (right & ~span.rightMask) | (frameRow[length - 1] & span.rightMask);
+            frameRow[0] = (left & ~span.leftMask) | (frameRow[0] & span.leftMask);
+        }
+        else
+        {
+            memcpy(cacheRow, frameRow, length);
+        }
+    }
+    
+    if(restore && !target)
+    {
+        // Restored rows may have been drawn over since the last frame, with row diffing only the changed ones are marked
+        displayMarkRows(display, display->rect.y + startRow, display->rect.y + endRow - 1);
+    }
+}
+
+static void displayFrameCacheStore(PDMode7_Display *display, _PDMode7_FrameKey *key, int complete, int startRow, int endRow)
+{
+    int sameKey = (memcmp(key, &display->frameKey, sizeof(_PDMode7_FrameKey)) == 0);
+    display->frameCacheFrames = sameKey ? (display->frameCacheFrames + 1) : 1;
+    display->frameKey = *key;
+    
+    // The frame is stored on the second draw with the same key, so a moving camera doesn't pay for the copy
+    // Temporal modes have drawn both phases by then
+    display->frameCacheValid = (complete || display->frameCacheFrames >= 2);
+    if(display->frameCacheValid)
+    {
+        displayFrameCacheCopy(display, display->frameCache, 0, startRow, endRow);
+    }
+}
+
+static void displayDiffRows(PDMode7_Display *display)
+{
+    uint8_t *framebuffer; int rowbytes;
+    displayGetFramebuffer(display, NULL, &framebuffer, &rowbytes);
+    
+    _PDMode7_FrameSpan span = displayFrameSpan(display);
+    int length = span.length;
+    int valid = display->rowShadowValid;
+    
+    // Rows equal to the last drawn frame are already on the screen
+    int skippedRows = 0;
+    int runStart = -1;
+    for(int y = span.startY; y <= span.endY; y++)
+    {
+        int changed = 0;
+        if(y < span.endY)
+        {
+            uint8_t *frameRow = framebuffer + y * rowbytes + span.startByte;
+            uint8_t *shadowRow = display->rowShadow + (y - span.startY) * length;
+            
+            changed = !valid || ((frameRow[0] ^ shadowRow[0]) & span.leftMask) || ((frameRow[length - 1] ^ shadowRow[length - 1]) & span.rightMask);
+            
+            // Inner bytes are compared a word at a time
+            int i = 1;
+            for(; !changed && i + 4 <= length - 1; i += 4)
+            {
+                uint32_t frameWord; uint32_t shadowWord;
+                memcpy(&frameWord, frameRow + i, 4);
+                memcpy(&shadowWord, shadowRow + i, 4);
+                changed = ((frameWord ^ shadowWord) != 0);
+            }
+            for(; !changed && i < length - 1; i++)
+            {
+                changed = ((frameRow[i] ^ shadowRow[i]) != 0);
+            }
+            
+            if(changed)
+            {
+                memcpy(shadowRow, frameRow, length);
+            }
+            else
+            {
+                skippedRows++;
+            }
+        }
+        
+        if(changed && runStart < 0)
+        {
+            runStart = y;
+        }
+        else if(!changed && runStart >= 0)
+        {
+            markFrameRows(runStart, y - 1);
+            runStart = -1;
+        }
+    }
+    
+    display->rowShadowValid = 1;
+    display->skippedRows = skippedRows;
+}
+
+static void displayInvalidate(PDMode7_Display *display)
+{
+    display->frameCacheValid = 0;
+    display->frameCacheFrames = 0;
+    display->temporal.valid = 0;
+    display->rowShadowValid = 0;
+    display->background->drawnValid = 0;
+}
+
+static void displayInvalidate_public(PDMode7_Display *display)
+{
+    // The background bitmap may have changed
+    displayInvalidate(display);
+    display->background->stripValid = 0;
+}
+
+static int planeGetDirtyRect(PDMode7_Plane *plane, unsigned int version, PDMode7_Rect *rect)
+{
+    *rect = newRect(0, 0, 0, 0);
+    
+    PDMode7_Bitmap *bitmap = plane->bitmap;
+    if(!bitmap || bitmap->version == version)
+    {
+        return 1;
+    }
+    
+    // Changes can be located only on a bitmap that is sampled once
+    // The dirty rect must cover every change since version
+    if(plane->tilemap || plane->addressMode != kMode7AddressModeFill || (int)(version - bitmap->dirtyVersion) < 0)
+    {
+        return 0;
+    }
+    
+    *rect = bitmap->dirtyRect;
+    return 1;
+}
+
+static PDMode7_Rect planeDirtyRectForRow(PDMode7_Plane *plane, PDMode7_Rect rect, _PDMode7_RowSetup *row)
+{
+    if(rect.width <= 0 || rect.height <= 0)
+    {
+        return rect;
+    }
+    
+    // Mip texels cover a block of texels at the row level
+    int lod = mode7_min(rowMipLevel(row), plane->bitmap->mipLevels);
+    int x0 = (rect.x >> lod) << lod;
+    int y0 = (rect.y >> lod) << lod;
+    int x1 = (((rect.x + rect.width - 1) >> lod) + 1) << lod;
+    int y1 = (((rect.y + rect.height - 1) >> lod) + 1) << lod;
+    
+    // One texel margin for rounding
+    return newRect(x0 - 1, y0 - 1, x1 - x0 + 2, y1 - y0 + 2);
+}
+
+static int displayGetDirtyRows(PDMode7_World *world, PDMode7_Display *display, _PDMode7_FrameKey *key, _PDMode7_Parameters *p)
+{
+    // Only the plane and the ceiling bitmaps may have changed since the cached frame
+    _PDMode7_FrameKey *frameKey = &display->frameKey;
+    _PDMode7_FrameKey bitmapKey = *key;
+    bitmapKey.planeVersion = frameKey->planeVersion;
+    bitmapKey.ceilingVersion = frameKey->ceilingVersion;
+    if(!display->frameCacheValid || memcmp(&bitmapKey, frameKey, sizeof(_PDMode7_FrameKey)) != 0)
+    {
+        return 0;
+    }
+    
+    PDMode7_Rect planeRect;
+    if(!planeGetDirtyRect(&world->plane, frameKey->planeVersion, &planeRect))
+    {
+        return 0;
+    }
+    PDMode7_Rect ceilingRect = newRect(0, 0, 0, 0);
+#if PD_MODE7_CEILING
+    if(!planeGetDirtyRect(&world->ceiling, frameKey->ceilingVersion, &ceilingRect))
+    {
+        return 0;
+    }
+#endif
+    
+    int xStep; int yStep;
+    getDisplayScaleStep(display->scale, &xStep, &yStep);
+    
+    _PDMode7_RowTableEntry *rows = displayGetRowTable(display, p, xStep, yStep);
+    
+    for(int y = 0; y < p->planeHeight; y += yStep)
+    {
+        _PDMode7_RowTableEntry *entry = &rows[y];
+        uint8_t flags = 0;
+        
+        if(!cameraIsBeyondFarDistance(display->camera, entry->distance))
+        {
+            // Rows are tested as they are sampled
+            _PDMode7_RowSetup row = entry->row;
+            int rowXStep = displayRowXStep(display, xStep, entry->distance);
+            if(rowXStep != xStep)
+            {
+                rowSetupStride(&entry->row, 0, rowXStep / xStep, &row);
+            }
+            
+            if(rowIntersectsRect(&row, planeDirtyRectForRow(&world->plane, planeRect, &row)))
+            {
+                flags |= 1;
+            }
+            if(rowIntersectsRect(&row, planeDirtyRectForRow(&world->ceiling, ceilingRect, &row)))
+            {
+                flags |= 2;
+            }
+        }
+        
+        display->dirtyRows[y / yStep] = flags;
+    }
+    
+    return 1;
+}
+
+static int displayCanMirror(PDMode7_Display *display, PDMode7_Display *source)
+{
+    // Same camera and same output, the rect can move by whole dither patterns
+    if(display->camera != source->camera || displayIsTransformed(display) || displayIsTransformed(source))
+    {
+        return 0;
+    }
+    if(display->rect.width != source->rect.width || display->rect.height != source->rect.height || ((display->rect.y - source->rect.y) & 7) != 0)
+    {
+        return 0;
+    }
+    if(display->scale != source->scale || display->ditherType != source->ditherType || display->adaptiveDistance2x != source->adaptiveDistance2x || display->adaptiveDistance4x != source->adaptiveDistance4x)
+    {
+        return 0;
+    }
+    if(display->temporal.mode != kMode7DisplayRenderModeFull || source->temporal.mode != kMode7DisplayRenderModeFull)
+    {
+        return 0;
+    }
+#if PD_MODE7_SHADER
+    if(display->planeShader != source->planeShader || display->ceilingShader != source->ceilingShader)
+    {
+        return 0;
+    }
+#endif
+    
+    PDMode7_Background *background = display->background;
+    PDMode7_Background *sourceBackground = source->background;
+    if(background->bitmap || sourceBackground->bitmap)
+    {
+        // Background is positioned from the top of the framebuffer
+        if(background->bitmap != sourceBackground->bitmap || display->rect.y != source->rect.y || background->center.x != sourceBackground->center.x || background->center.y != sourceBackground->center.y || background->roundingIncrement.x != sourceBackground->roundingIncrement.x || background->roundingIncrement.y != sourceBackground->roundingIncrement.y)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+static void worldDrawDisplay(PDMode7_World *pWorld, PDMode7_Display *display, PDMode7_Display *source, int storeFrame)
+{
     _PDMode7_Parameters parameters = worldGetParameters(display);
     
+    displayPrepareFramebuffer(display);
+    
+    // If nothing changed since the last complete frame, only sprites are drawn
+    // If only plane bitmaps changed, the affected rows are drawn over the last frame
+    // A mirror display copies the frame drawn by its source
+    _PDMode7_FrameKey frameKey = displayFrameKey(pWorld, display);
+    int mirrored = (source && source->frameCacheValid && memcmp(&frameKey, &source->frameKey, sizeof(_PDMode7_FrameKey)) == 0);
+    int cached = (!mirrored && display->frameCacheValid && memcmp(&frameKey, &display->frameKey, sizeof(_PDMode7_FrameKey)) == 0);
+    int dirty = (!mirrored && !cached && displayGetDirtyRows(pWorld, display, &frameKey, &parameters));
+    if(!cached && !dirty)
+    {
+        displayTemporalBegin(display, &parameters);
+    }
+    
+    // Background is drawn down to the horizon
+    // If plane rows are kept from the previous frame, it must not overwrite the ceiling
+    int backgroundHeight = parameters.horizon;
+#if PD_MODE7_CEILING
+    if(display->temporal.partial && (pWorld->ceiling.bitmap || pWorld->ceiling.tilemap))
+    {
+        backgroundHeight = mode7_max(parameters.horizon - parameters.planeHeight, 0);
+    }
+#endif
+    
     LCDBitmap *target;
     displayGetFramebuffer(display, &target, NULL, NULL);
     
+    // Rows kept in the frame cache, the background is drawn again if it's not one of them
+    int cacheStart; int cacheEnd;
+    displayFrameCacheRows(pWorld, display, &parameters, &cacheStart, &cacheEnd);
+    int restored = (cached || dirty || mirrored);
+    int cachesRect = (target || displayIsTransformed(display));
+    
+    if(mirrored)
+    {
+        // The display doesn't keep its own frame
+        displayInvalidate(display);
+    }
+    
     playdate->graphics->pushContext(target);
     
-    if(target)
+    // Transformed displays are cleared, as they were when drawn to a secondary framebuffer
+    if(cachesRect && !restored)
+    {
+        int clearHeight = display->temporal.partial ? backgroundHeight : display->rect.height;
+        PDMode7_Rect clearRect = displayFrameRect(display, newRect(display->rect.x, display->rect.y, display->rect.width, clearHeight));
+        playdate->graphics->fillRect(clearRect.x, clearRect.y, clearRect.width, clearRect.height, kColorWhite);
+    }
+    
+    if(!target && (displayIsTransformed(display) || displayNeedsClip(display)))
     {
-        playdate->graphics->clear(kColorWhite);
+        PDMode7_Rect clipRect = displayFrameRect(display, display->rect);
+        playdate->graphics->setClipRect(clipRect.x, clipRect.y, clipRect.width, clipRect.height);
     }
     
-    if(!target && displayNeedsClip(display))
+    if(!restored || !cachesRect)
+    {
+        drawBackground(display, &parameters, backgroundHeight);
+    }
+    
+    if(cached || dirty)
+    {
+        displayFrameCacheCopy(display, display->frameCache, 1, cacheStart, cacheEnd);
+    }
+    else if(mirrored)
     {
-        playdate->graphics->setClipRect(display->rect.x, display->rect.y, display->rect.width, display->rect.height);
+        displayFrameCacheCopy(display, source->frameCache, 1, cacheStart, cacheEnd);
     }
     
+    if(!cached && !mirrored)
+    {
 #if PD_MODE7_SHADER
-    shaderPrepare(display->planeShader, display, &parameters);
+        shaderPrepare(display->planeShader, display, &parameters);
 #if PD_MODE7_CEILING
-    shaderPrepare(display->ceilingShader, display, &parameters);
+        shaderPrepare(display->ceilingShader, display, &parameters);
 #endif
 #endif
+        drawPlane(pWorld, display, &parameters, dirty ? display->dirtyRows : NULL);
+        displayFrameCacheStore(display, &frameKey, dirty || storeFrame, cacheStart, cacheEnd);
+        
+        // Changes are drawn, the next ones are accumulated from here
+        if(pWorld->plane.bitmap)
+        {
+            bitmapClearDirtyRect(pWorld->plane.bitmap);
+        }
+        if(pWorld->ceiling.bitmap)
+        {
+            bitmapClearDirtyRect(pWorld->ceiling.bitmap);
+        }
+    }
     
-    drawBackground(display, &parameters);
-    drawPlane(pWorld, display, &parameters);
     drawSprites(display);
+    displayUpdateSpriteRows(display);
+    
+    display->skippedRows = 0;
+    if(display->rowDiffing && !target)
+    {
+        displayDiffRows(display);
+    }
     
     playdate->graphics->popContext();
     
@@ -1155,6 +2957,81 @@ static void worldDraw(PDMode7_World *pWorld, PDMode7_Display *display)
     }
 }
 
+static void worldDraw(PDMode7_World *pWorld, PDMode7_Display *display)
+{
+    display = getDisplay(pWorld, display);
+    int displayIndex = indexForDisplay(pWorld, display);
+    if(displayIndex < 0)
+    {
+        return;
+    }
+    
+    worldDrawDisplay(pWorld, display, NULL, 0);
+}
+
+static void worldDrawAll(PDMode7_World *pWorld)
+{
+    PDMode7_Display *sources[MODE7_MAX_DISPLAYS];
+    int storeFrame[MODE7_MAX_DISPLAYS];
+    
+    // Displays with the same camera and output are drawn once
+    for(int i = 0; i < pWorld->numberOfDisplays; i++)
+    {
+        sources[i] = NULL;
+        storeFrame[i] = 0;
+        
+        for(int j = 0; j < i; j++)
+        {
+            if(!sources[j] && displayCanMirror(pWorld->displays[i], pWorld->displays[j]))
+            {
+                sources[i] = pWorld->displays[j];
+                storeFrame[j] = 1;
+                break;
+            }
+        }
+    }
+    
+    batchingRows = 1;
+    
+    for(int i = 0; i < pWorld->numberOfDisplays; i++)
+    {
+        worldDrawDisplay(pWorld, pWorld->displays[i], sources[i], storeFrame[i]);
+    }
+    
+    batchingRows = 0;
+    flushBatchedRows();
+}
+
+static inline int wrapCoordinate(int value, int size, PDMode7_AddressMode addressMode)
+{
+    int period = (addressMode == kMode7AddressModeMirroredRepeat) ? size * 2 : size;
+    value %= period;
+    if(value < 0)
+    {
+        value += period;
+    }
+    if(value >= size)
+    {
+        // Odd periods are mirrored
+        value = period - 1 - value;
+    }
+    return value;
+}
+
+static inline uint8_t bitmapColorAtAddress(PDMode7_Plane *plane, PDMode7_Bitmap *bitmap, int x, int y)
+{
+    if(plane->addressMode != kMode7AddressModeFill && bitmap->width > 0 && bitmap->height > 0)
+    {
+        x = wrapCoordinate(x, bitmap->width, plane->addressMode);
+        y = wrapCoordinate(y, bitmap->height, plane->addressMode);
+    }
+    if(x >= 0 && x < bitmap->width && y >= 0 && y < bitmap->height)
+    {
+        return bitmap->data[bitmapOffset(bitmap, x, y)];
+    }
+    return plane->fillColor.gray;
+}
+
 static inline uint8_t planeColorAt(PDMode7_World *world, PDMode7_Plane *plane, int x, int y)
 {
 #if PD_MODE7_TILEMAP
@@ -1174,7 +3051,7 @@ static inline uint8_t planeColorAt(PDMode7_World *world, PDMode7_Plane *plane, i
             
             if(tile->bitmap)
             {
-                return tile->bitmap->data[tileY * tile->bitmap->width + tileX];
+                return tile->bitmap->data[bitmapOffset(tile->bitmap, tileX, tileY)];
             }
         }
         else if(tilemap->fillBitmap)
@@ -1182,87 +3059,23 @@ static inline uint8_t planeColorAt(PDMode7_World *world, PDMode7_Plane *plane, i
             int tileX = (x & (tilemap->tileWidth - 1)) >> tilemap->fillBitmapScale_log;
             int tileY = (y & (tilemap->tileHeight - 1)) >> tilemap->fillBitmapScale_log;
             
-            return tilemap->fillBitmap->data[tileY * tilemap->fillBitmap->width + tileX];
+            return tilemap->fillBitmap->data[bitmapOffset(tilemap->fillBitmap, tileX, tileY)];
         }
     }
-    else if(bitmap && x >= 0 && x < bitmap->width && y >= 0 && y < bitmap->height)
+    else if(bitmap)
     {
-        return bitmap->data[bitmap->width * y + x];
+        return bitmapColorAtAddress(plane, bitmap, x, y);
     }
 #else
     PDMode7_Bitmap *bitmap = plane->bitmap;
-    if(bitmap && x >= 0 && x < bitmap->width && y >= 0 && y < bitmap->height)
+    if(bitmap)
     {
-        return bitmap->data[bitmap->width * y + x];
+        return bitmapColorAtAddress(plane, bitmap, x, y);
     }
 #endif
     return plane->fillColor.gray;
 }
 
-static inline void worldSetColor(uint8_t color, PDMode7_DisplayScale displayScale, uint8_t *ptr, int rowbytes, _PDMode7_DitherPattern p, int bit, int y, int dy)
-{
-    uint8_t patternIndex = (color * p.len) >> 8;
-    
-    switch(displayScale)
-    {
-        case kMode7DisplayScale1x1:
-        {
-            uint8_t pattern = p.data[(patternIndex << p.mul) + (y & p.mod)];
-            uint8_t mask = 0b00000001 << (7 - bit);
-            
-            *ptr = (*ptr & ~mask) | (pattern & mask);
-            
-            break;
-        }
-        case kMode7DisplayScale2x1:
-        {
-            uint8_t pattern = p.data[(patternIndex << p.mul) + (y & p.mod)];
-            uint8_t mask = 0b00000011 << (6 - bit);
-            
-            *ptr = (*ptr & ~mask) | (pattern & mask);
-            
-            break;
-        }
-        case kMode7DisplayScale2x2:
-        {
-            uint8_t pattern1 = p.data[(patternIndex << p.mul) + (y & p.mod)];
-            uint8_t pattern2 = p.data[(patternIndex << p.mul) + ((y + dy) & p.mod)];
-
-            uint8_t mask = 0b00000011 << (6 - bit);
-            
-            *ptr = (*ptr & ~mask) | (pattern1 & mask);
-            ptr += rowbytes;
-            *ptr = (*ptr & ~mask) | (pattern2 & mask);
-
-            break;
-        }
-        case kMode7DisplayScale4x1:
-        {
-            uint8_t pattern = p.data[(patternIndex << p.mul) + (y & p.mod)];
-            uint8_t mask = 0b00001111 << (4 - bit);
-            
-            *ptr = (*ptr & ~mask) | (pattern & mask);
-            
-            break;
-        }
-        case kMode7DisplayScale4x2:
-        {
-            uint8_t pattern1 = p.data[(patternIndex << p.mul) + (y & p.mod)];
-            uint8_t pattern2 = p.data[(patternIndex << p.mul) + ((y + dy) & p.mod)];
-
-            uint8_t mask = 0b00001111 << (4 - bit);
-            
-            *ptr = (*ptr & ~mask) | (pattern1 & mask);
-            ptr += rowbytes;
-            *ptr = (*ptr & ~mask) | (pattern2 & mask);
-            
-            break;
-        }
-        default:
-            break;
-    }
-}
-
 static PDMode7_Vec3 displayToPlanePoint(PDMode7_Display *display, int displayX, int displayY, _PDMode7_Parameters *p)
 {
     PDMode7_Camera *camera = display->camera;
@@ -1336,7 +3149,7 @@ static void shaderPrepare(PDMode7_Shader *shader, PDMode7_Display *display, _PDM
     }
 }
 
-static void shaderPrepareRow(PDMode7_Shader *shader, PDMode7_Display *display, int y, _PDMode7_Parameters *p)
+static void shaderPrepareRow(PDMode7_Shader *shader, float distance, _PDMode7_Parameters *p)
 {
     if(!shader)
     {
@@ -1350,7 +3163,6 @@ static void shaderPrepareRow(PDMode7_Shader *shader, PDMode7_Display *display, i
             PDMode7_LinearShader *linear = shader->object;
             
             float progress = 1;
-            float distance = distanceAtScanline(p->horizon + y, display, p);
             if(!isinf(distance)){
                 progress = linearShaderProgress(linear, distance);
             }
@@ -1779,11 +3591,13 @@ static PDMode7_Bitmap* getPlaneBitmap(PDMode7_World *world)
 static void setPlaneBitmap(PDMode7_World *world, PDMode7_Bitmap *bitmap)
 {
     setPlaneBitmap_generic(&world->plane, bitmap);
+    world->version++;
 }
 
 static void setPlaneFillColor(PDMode7_World *world, PDMode7_Color color)
 {
     world->plane.fillColor = color;
+    world->version++;
 }
 
 static PDMode7_Color getPlaneFillColor(PDMode7_World *world)
@@ -1799,11 +3613,13 @@ static PDMode7_Bitmap* getCeilingBitmap(PDMode7_World *world)
 static void setCeilingBitmap(PDMode7_World *world, PDMode7_Bitmap *bitmap)
 {
     setPlaneBitmap_generic(&world->ceiling, bitmap);
+    world->version++;
 }
 
 static void setCeilingFillColor(PDMode7_World *world, PDMode7_Color color)
 {
     world->ceiling.fillColor = color;
+    world->version++;
 }
 
 static PDMode7_Color getCeilingFillColor(PDMode7_World *world)
@@ -1814,6 +3630,7 @@ static PDMode7_Color getCeilingFillColor(PDMode7_World *world)
 static void setPlaneTilemap(PDMode7_World *world, PDMode7_Tilemap *tilemap)
 {
     setPlaneTilemap_generic(&world->plane, tilemap);
+    world->version++;
 }
 
 static PDMode7_Tilemap* getPlaneTilemap(PDMode7_World *world)
@@ -1824,6 +3641,7 @@ static PDMode7_Tilemap* getPlaneTilemap(PDMode7_World *world)
 static void setCeilingTilemap(PDMode7_World *world, PDMode7_Tilemap *tilemap)
 {
     setPlaneTilemap_generic(&world->ceiling, tilemap);
+    world->version++;
 }
 
 static PDMode7_Tilemap* getCeilingTilemap(PDMode7_World *world)
@@ -1831,6 +3649,28 @@ static PDMode7_Tilemap* getCeilingTilemap(PDMode7_World *world)
     return world->ceiling.tilemap;
 }
 
+static void setPlaneAddressMode(PDMode7_World *world, PDMode7_AddressMode addressMode)
+{
+    world->plane.addressMode = addressMode;
+    world->version++;
+}
+
+static PDMode7_AddressMode getPlaneAddressMode(PDMode7_World *world)
+{
+    return world->plane.addressMode;
+}
+
+static void setCeilingAddressMode(PDMode7_World *world, PDMode7_AddressMode addressMode)
+{
+    world->ceiling.addressMode = addressMode;
+    world->version++;
+}
+
+static PDMode7_AddressMode getCeilingAddressMode(PDMode7_World *world)
+{
+    return world->ceiling.addressMode;
+}
+
 static void releasePlane(PDMode7_Plane *plane)
 {
     if(plane->bitmap)
@@ -1895,18 +3735,49 @@ static PDMode7_Display* newDisplay(int x, int y, int width, int height)
     display->rect = newRect(0, 0, 0, 0);
     display->absoluteRect = newRect(0, 0, 0, 0);
     display->scale = kMode7DisplayScale2x2;
+    display->adaptiveDistance2x = 0;
+    display->adaptiveDistance4x = 0;
     display->ditherType = kMode7DitherBayer4x4;
     display->orientation = kMode7DisplayOrientationLandscapeLeft;
     display->flipMode = kMode7DisplayFlipModeNone;
     display->secondaryFramebuffer = NULL;
+    display->drawsToSecondary = 0;
+    display->lineBuffer = NULL;
+    display->rowColors = NULL;
+    
+    display->rowTable = playdate->system->realloc(NULL, sizeof(_PDMode7_RowTable));
+    display->rowTable->rows = NULL;
+    display->rowTable->capacity = 0;
+    display->rowTable->valid = 0;
+    
+    display->parametersCamera = NULL;
+    display->parametersCameraVersion = 0;
+    display->parametersValid = 0;
+    
+    display->temporal.mode = kMode7DisplayRenderModeFull;
+    display->temporal.refreshDistance = 8;
+    display->temporal.refreshAngle = 0.05f;
+    display->temporal.frame = 0;
+    display->temporal.valid = 0;
+    display->temporal.partial = 0;
+    display->temporal.camera = NULL;
+    
+    memset(&display->frameKey, 0, sizeof(_PDMode7_FrameKey));
+    display->frameCache = NULL;
+    display->frameCacheFrames = 0;
+    display->frameCacheValid = 0;
+    display->rowDiffing = 0;
+    display->rowShadow = NULL;
+    display->rowShadowValid = 0;
+    display->skippedRows = 0;
+    display->spriteRows = NULL;
+    display->dirtyRows = NULL;
     
     display->visibleInstances = newArray();
+    display->closeSprites = newArray();
     display->planeShader = NULL;
     display->ceilingShader = NULL;
 
-    displaySetRect(display, x, y, width, height);
-    displaySetOrientation(display, kMode7DisplayOrientationLandscapeLeft);
-    
     PDMode7_Background *background = playdate->system->realloc(NULL, sizeof(PDMode7_Background));
     display->background = background;
     
@@ -1917,6 +3788,17 @@ static PDMode7_Display* newDisplay(int x, int y, int width, int height)
     background->height = 0;
     background->center = newVec2(0.5, 0.5);
     background->roundingIncrement = newVec2ui(1, 1);
+    background->strip = NULL;
+    background->stripMask = NULL;
+    background->stripRowbytes = 0;
+    background->stripDisplayWidth = 0;
+    background->stripValid = 0;
+    background->drawnOffset = newVec2(0, 0);
+    background->drawnHeight = 0;
+    background->drawnValid = 0;
+    
+    displaySetRect(display, x, y, width, height);
+    displaySetOrientation(display, kMode7DisplayOrientationLandscapeLeft);
     
     display->isManaged = 0;
     display->luaRef = NULL;
@@ -1932,6 +3814,26 @@ static PDMode7_DisplayScale displayGetScale(PDMode7_Display *display)
 static void displaySetScale(PDMode7_Display *display, PDMode7_DisplayScale scale)
 {
     display->scale = scale;
+    displayInvalidate(display);
+}
+
+static void displayGetAdaptiveScale(PDMode7_Display *display, float *distance2x, float *distance4x)
+{
+    if(distance2x)
+    {
+        *distance2x = display->adaptiveDistance2x;
+    }
+    if(distance4x)
+    {
+        *distance4x = display->adaptiveDistance4x;
+    }
+}
+
+static void displaySetAdaptiveScale(PDMode7_Display *display, float distance2x, float distance4x)
+{
+    display->adaptiveDistance2x = fmaxf(distance2x, 0);
+    display->adaptiveDistance4x = fmaxf(distance4x, 0);
+    displayInvalidate(display);
 }
 
 static PDMode7_DitherType displayGetDitherType(PDMode7_Display *display)
@@ -1944,9 +3846,64 @@ static void displaySetDitherType(PDMode7_Display *display, PDMode7_DitherType ty
     if(type >= 0 && type < 3)
     {
         display->ditherType = type;
+        displayInvalidate(display);
+    }
+}
+
+static PDMode7_DisplayRenderMode displayGetRenderMode(PDMode7_Display *display)
+{
+    return display->temporal.mode;
+}
+
+static void displaySetRenderMode(PDMode7_Display *display, PDMode7_DisplayRenderMode mode)
+{
+    if(mode >= 0 && mode < 3 && mode != display->temporal.mode)
+    {
+        display->temporal.mode = mode;
+        displayInvalidate(display);
     }
 }
 
+static int displayGetRowDiffing(PDMode7_Display *display)
+{
+    return display->rowDiffing;
+}
+
+static void displaySetRowDiffing(PDMode7_Display *display, int flag)
+{
+    flag = flag ? 1 : 0;
+    if(flag != display->rowDiffing)
+    {
+        display->rowDiffing = flag;
+        display->rowShadowValid = 0;
+        display->skippedRows = 0;
+        display->rowShadow = playdate->system->realloc(display->rowShadow, flag ? displayFrameSize(display) : 0);
+    }
+}
+
+static int displayGetSkippedRows(PDMode7_Display *display)
+{
+    return display->skippedRows;
+}
+
+static void displayGetRefreshThreshold(PDMode7_Display *display, float *distance, float *angle)
+{
+    if(distance)
+    {
+        *distance = display->temporal.refreshDistance;
+    }
+    if(angle)
+    {
+        *angle = display->temporal.refreshAngle;
+    }
+}
+
+static void displaySetRefreshThreshold(PDMode7_Display *display, float distance, float angle)
+{
+    display->temporal.refreshDistance = fmaxf(distance, 0);
+    display->temporal.refreshAngle = fmaxf(angle, 0);
+}
+
 static PDMode7_Camera* displayGetCamera(PDMode7_Display *display)
 {
     return display->camera;
@@ -1966,6 +3923,8 @@ static void displaySetCamera(PDMode7_Display *display, PDMode7_Camera *camera)
     }
     
     display->camera = camera;
+    display->parametersValid = 0;
+    displayInvalidate(display);
 }
 
 static PDMode7_Background* displayGetBackground(PDMode7_Display *display)
@@ -1989,6 +3948,7 @@ static void displaySetPlaneShader(PDMode7_Display *display, PDMode7_Shader *shad
         releaseShader(display->planeShader);
     }
     display->planeShader = shader;
+    displayInvalidate(display);
 }
 
 static PDMode7_Shader* displayGetCeilingShader(PDMode7_Display *display)
@@ -2007,6 +3967,7 @@ static void displaySetCeilingShader(PDMode7_Display *display, PDMode7_Shader *sh
         releaseShader(display->ceilingShader);
     }
     display->ceilingShader = shader;
+    displayInvalidate(display);
 }
 
 static int displayNeedsClip(PDMode7_Display *display)
@@ -2014,6 +3975,11 @@ static int displayNeedsClip(PDMode7_Display *display)
     return (display->rect.width < LCD_COLUMNS || display->rect.height < LCD_ROWS);
 }
 
+static int displayIsTransformed(PDMode7_Display *display)
+{
+    return (display->orientation != kMode7DisplayOrientationLandscapeLeft || display->flipMode != kMode7DisplayFlipModeNone);
+}
+
 static void displayRectDidChange(PDMode7_Display *display)
 {
     if(display->secondaryFramebuffer)
@@ -2021,14 +3987,49 @@ static void displayRectDidChange(PDMode7_Display *display)
         playdate->graphics->freeBitmap(display->secondaryFramebuffer);
         display->secondaryFramebuffer = NULL;
     }
+    display->drawsToSecondary = 0;
     
     display->rect = display->absoluteRect;
+    display->parametersValid = 0;
     
-    if(display->orientation != kMode7DisplayOrientationLandscapeLeft || display->flipMode != kMode7DisplayFlipModeNone)
+    if(displayIsTransformed(display))
     {
-        display->secondaryFramebuffer = playdate->graphics->newBitmap(display->absoluteRect.width, display->absoluteRect.height, kColorWhite);
+        // Drawing is in display space, it's transformed when written to the framebuffer
         display->rect = newRect(0, 0, display->absoluteRect.width, display->absoluteRect.height);
     }
+    
+    // Row samples for plane and ceiling, padded to a whole byte
+    display->rowColors = playdate->system->realloc(display->rowColors, (mode7_max(display->rect.width, 0) + 8) * 2);
+    
+    // Retained rows and cached frame are lost when the framebuffer changes
+    displayInvalidate(display);
+    display->spriteRows = playdate->system->realloc(display->spriteRows, mode7_max(display->rect.height, 0) + 1);
+    memset(display->spriteRows, 0, mode7_max(display->rect.height, 0) + 1);
+    display->dirtyRows = playdate->system->realloc(display->dirtyRows, mode7_max(display->rect.height, 0) + 1);
+    
+    // Rows merged by column or transformed before being written
+    display->lineBuffer = playdate->system->realloc(display->lineBuffer, mode7_max(display->rect.width, 0) / 8 + 8);
+    
+    // Background and plane of the last complete frame
+    display->frameCache = playdate->system->realloc(display->frameCache, displayFrameSize(display));
+    
+    if(display->rowDiffing)
+    {
+        display->rowShadow = playdate->system->realloc(display->rowShadow, displayFrameSize(display));
+    }
+}
+
+static int displayFrameSize(PDMode7_Display *display)
+{
+    // Bytes of the display region, stored in framebuffer layout
+    int width = mode7_max(display->rect.width, 0);
+    int height = mode7_max(display->rect.height, 0);
+    if(display->orientation == kMode7DisplayOrientationPortrait || display->orientation == kMode7DisplayOrientationPortraitUpsideDown)
+    {
+        // Columns may not be byte aligned
+        return (height / 8 + 2) * width;
+    }
+    return width / 8 * height;
 }
 
 static PDMode7_Rect displayGetRect(PDMode7_Display *display)
@@ -2105,7 +4106,34 @@ static PDMode7_Vec2 displayConvertPointFromOrientation(PDMode7_Display *display,
         }
         case kMode7DisplayOrientationPortraitUpsideDown:
         {
-            return newVec2(y, display->rect.width - x);
+            return newVec2(y, display->rect.width - x);
+            break;
+        }
+        default:
+        {
+            return newVec2(x, y);
+            break;
+        }
+    }
+}
+
+static PDMode7_Vec2 displayConvertPointToOrientation(PDMode7_Display *display, float x, float y)
+{
+    switch(display->orientation)
+    {
+        case kMode7DisplayOrientationLandscapeRight:
+        {
+            return newVec2(display->rect.width - x, display->rect.height - y);
+            break;
+        }
+        case kMode7DisplayOrientationPortrait:
+        {
+            return newVec2(y, display->rect.height - x);
+            break;
+        }
+        case kMode7DisplayOrientationPortraitUpsideDown:
+        {
+            return newVec2(display->rect.width - y, x);
             break;
         }
         default:
@@ -2116,36 +4144,249 @@ static PDMode7_Vec2 displayConvertPointFromOrientation(PDMode7_Display *display,
     }
 }
 
-static PDMode7_Vec2 displayConvertPointToOrientation(PDMode7_Display *display, float x, float y)
+static void displayPrepareFramebuffer(PDMode7_Display *display)
 {
+    int secondary = 0;
+    if(displayIsTransformed(display))
+    {
+        // Custom sprite drawing can't be transformed, these frames are drawn to a secondary framebuffer
+        for(int i = 0; i < display->visibleInstances->length; i++)
+        {
+            PDMode7_SpriteInstance *instance = display->visibleInstances->items[i];
+            if(instance->drawCallback)
+            {
+                secondary = 1;
+                break;
+            }
+        }
+    }
+    
+    if(secondary && !display->secondaryFramebuffer)
+    {
+        display->secondaryFramebuffer = playdate->graphics->newBitmap(display->absoluteRect.width, display->absoluteRect.height, kColorWhite);
+    }
+    
+    if(secondary != display->drawsToSecondary)
+    {
+        // Retained rows are in the other framebuffer
+        displayInvalidate(display);
+        display->drawsToSecondary = secondary;
+    }
+    
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    t->x = 0;
+    t->y = 0;
+    t->xx = 1;
+    t->xy = 0;
+    t->yx = 0;
+    t->yy = 1;
+    t->width = LCD_COLUMNS;
+    t->height = LCD_ROWS;
+    
+    if(secondary)
+    {
+        t->width = display->absoluteRect.width;
+        t->height = display->absoluteRect.height;
+        return;
+    }
+    
+    if(!displayIsTransformed(display))
+    {
+        return;
+    }
+    
+    PDMode7_Rect rect = display->absoluteRect;
+    int flipX = (display->flipMode == kMode7DisplayFlipModeX || display->flipMode == kMode7DisplayFlipModeXY);
+    int flipY = (display->flipMode == kMode7DisplayFlipModeY || display->flipMode == kMode7DisplayFlipModeXY);
+    
     switch(display->orientation)
     {
         case kMode7DisplayOrientationLandscapeRight:
         {
-            return newVec2(display->rect.width - x, display->rect.height - y);
+            // Rotated by 180 degrees
+            rect.x = LCD_COLUMNS - (rect.width + rect.x);
+            rect.y = LCD_ROWS - (rect.height + rect.y);
+            flipX = !flipX;
+            flipY = !flipY;
+        }
+        // fall through
+        case kMode7DisplayOrientationLandscapeLeft:
+        {
+            t->x = flipX ? (rect.x + rect.width - 1) : rect.x;
+            t->y = flipY ? (rect.y + rect.height - 1) : rect.y;
+            t->xx = flipX ? -1 : 1;
+            t->yy = flipY ? -1 : 1;
             break;
         }
         case kMode7DisplayOrientationPortrait:
         {
-            return newVec2(y, display->rect.height - x);
+            // Display rows are framebuffer columns, from right to left
+            t->x = LCD_COLUMNS - 1 - rect.y;
+            t->y = rect.x;
+            t->xx = 0;
+            t->xy = 1;
+            t->yx = -1;
+            t->yy = 0;
             break;
         }
         case kMode7DisplayOrientationPortraitUpsideDown:
         {
-            return newVec2(display->rect.width - y, x);
+            // Display rows are framebuffer columns, from left to right
+            t->x = rect.y;
+            t->y = LCD_ROWS - 1 - rect.x;
+            t->xx = 0;
+            t->xy = -1;
+            t->yx = 1;
+            t->yy = 0;
             break;
         }
         default:
-        {
-            return newVec2(x, y);
             break;
+    }
+}
+
+static PDMode7_Rect displayFrameRect(PDMode7_Display *display, PDMode7_Rect rect)
+{
+    if(rect.width <= 0 || rect.height <= 0)
+    {
+        return newRect(0, 0, 0, 0);
+    }
+    
+    // Bounds of the transformed corners
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    int x1 = rect.x + rect.width - 1;
+    int y1 = rect.y + rect.height - 1;
+    int frameX0 = t->x + rect.x * t->xx + rect.y * t->yx;
+    int frameY0 = t->y + rect.x * t->xy + rect.y * t->yy;
+    int frameX1 = t->x + x1 * t->xx + y1 * t->yx;
+    int frameY1 = t->y + x1 * t->xy + y1 * t->yy;
+    
+    int minX = mode7_min(frameX0, frameX1);
+    int minY = mode7_min(frameY0, frameY1);
+    return newRect(minX, minY, mode7_max(frameX0, frameX1) - minX + 1, mode7_max(frameY0, frameY1) - minY + 1);
+}
+
+static void displayDrawBitmap(PDMode7_Display *display, LCDBitmap *bitmap, int x, int y)
+{
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    
+    int width; int height;
+    playdate->graphics->getBitmapData(bitmap, &width, &height, NULL, NULL, NULL);
+    PDMode7_Rect frameRect = displayFrameRect(display, newRect(x, y, width, height));
+    
+    if(t->xy == 0)
+    {
+        LCDBitmapFlip bitmapFlip = kBitmapUnflipped;
+        if(t->xx < 0 && t->yy < 0)
+        {
+            bitmapFlip = kBitmapFlippedXY;
+        }
+        else if(t->xx < 0)
+        {
+            bitmapFlip = kBitmapFlippedX;
+        }
+        else if(t->yy < 0)
+        {
+            bitmapFlip = kBitmapFlippedY;
+        }
+        playdate->graphics->drawBitmap(bitmap, frameRect.x, frameRect.y, bitmapFlip);
+    }
+    else
+    {
+        playdate->graphics->drawRotatedBitmap(bitmap, frameRect.x, frameRect.y, (t->xy > 0) ? 90 : -90, 0, 0, 1, 1);
+    }
+}
+
+static void displayMarkRows(PDMode7_Display *display, int startY, int endY)
+{
+    if(display->rowDiffing && !display->drawsToSecondary)
+    {
+        // Changed rows are marked after drawing
+        return;
+    }
+    
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    
+    PDMode7_Rect rows = newRect(display->rect.x, startY, display->rect.width, endY - startY + 1);
+    if(t->xy == 0)
+    {
+        rows.x = 0;
+        rows.width = 1;
+    }
+    
+    // Display rows may be framebuffer columns, all the covered rows are marked
+    PDMode7_Rect frameRect = displayFrameRect(display, rows);
+    int frameY0 = mode7_max(frameRect.y, 0);
+    int frameY1 = mode7_min(frameRect.y + frameRect.height, LCD_ROWS) - 1;
+    if(frameY1 < frameY0)
+    {
+        return;
+    }
+    
+    markFrameRows(frameY0, frameY1);
+}
+
+static void markFrameRows(int startY, int endY)
+{
+    if(batchingRows)
+    {
+        memset(batchedRows + startY, 1, endY - startY + 1);
+    }
+    else
+    {
+        playdate->graphics->markUpdatedRows(startY, endY);
+    }
+}
+
+static _PDMode7_FrameSpan displayFrameSpan(PDMode7_Display *display)
+{
+    _PDMode7_FrameTransform *t = &display->frameTransform;
+    PDMode7_Rect frameRect = displayFrameRect(display, display->rect);
+    int frameX0 = mode7_max(frameRect.x, 0);
+    int frameX1 = mode7_min(frameRect.x + frameRect.width, t->width) - 1;
+    
+    _PDMode7_FrameSpan span;
+    span.startY = mode7_max(frameRect.y, 0);
+    span.endY = mode7_min(frameRect.y + frameRect.height, t->height);
+    span.startByte = frameX0 / 8;
+    span.length = frameX1 / 8 - span.startByte + 1;
+    span.leftMask = 0xFF >> (frameX0 & 7);
+    span.rightMask = 0xFF << (7 - (frameX1 & 7));
+    if(span.length == 1)
+    {
+        span.leftMask &= span.rightMask;
+    }
+    if(frameX1 < frameX0)
+    {
+        span.endY = span.startY;
+    }
+    return span;
+}
+
+static void flushBatchedRows(void)
+{
+    // One call for each run of marked rows
+    int runStart = -1;
+    for(int y = 0; y <= LCD_ROWS; y++)
+    {
+        int marked = (y < LCD_ROWS && batchedRows[y]);
+        if(marked && runStart < 0)
+        {
+            runStart = y;
+        }
+        else if(!marked && runStart >= 0)
+        {
+            playdate->graphics->markUpdatedRows(runStart, y - 1);
+            runStart = -1;
         }
     }
+    
+    memset(batchedRows, 0, LCD_ROWS);
 }
 
 static void displayGetFramebuffer(PDMode7_Display *display, LCDBitmap **target, uint8_t **framebuffer, int *rowbytes)
 {
-    if(!display->secondaryFramebuffer)
+    if(!display->drawsToSecondary)
     {
         if(target)
         {
@@ -2225,6 +4466,8 @@ static void backgroundSetBitmap(PDMode7_Background *background, LCDBitmap *bitma
     background->luaBitmap = luaBitmap;
     background->width = 0;
     background->height = 0;
+    background->stripValid = 0;
+    background->drawnValid = 0;
     
     if(bitmap)
     {
@@ -2234,6 +4477,8 @@ static void backgroundSetBitmap(PDMode7_Background *background, LCDBitmap *bitma
         background->width = width;
         background->height = height;
     }
+    
+    displayInvalidate(background->display);
 }
 
 static void backgroundSetBitmap_public(PDMode7_Background *background, LCDBitmap *bitmap)
@@ -2250,6 +4495,7 @@ static void backgroundSetCenter(PDMode7_Background *background, float x, float y
 {
     background->center.x = x;
     background->center.y = y;
+    displayInvalidate(background->display);
 }
 
 static void backgroundGetRoundingIncrement(PDMode7_Background *background, unsigned int *x, unsigned int *y)
@@ -2262,6 +4508,7 @@ static void backgroundSetRoundingIncrement(PDMode7_Background *background, unsig
 {
     background->roundingIncrement.x = x;
     background->roundingIncrement.y = y;
+    displayInvalidate(background->display);
 }
 
 static PDMode7_Vec2 backgroundGetOffset(PDMode7_Background *background, _PDMode7_Parameters *parameters)
@@ -2317,6 +4564,16 @@ static void freeDisplay(PDMode7_Display *display)
             playdate->graphics->freeBitmap(display->secondaryFramebuffer);
         }
         
+        playdate->system->realloc(display->rowColors, 0);
+        playdate->system->realloc(display->spriteRows, 0);
+        playdate->system->realloc(display->dirtyRows, 0);
+        playdate->system->realloc(display->lineBuffer, 0);
+        playdate->system->realloc(display->frameCache, 0);
+        playdate->system->realloc(display->rowShadow, 0);
+        
+        playdate->system->realloc(display->rowTable->rows, 0);
+        playdate->system->realloc(display->rowTable, 0);
+        
         if(display->camera && display->camera->luaRef)
         {
             GC_release(display->camera->luaRef);
@@ -2338,9 +4595,12 @@ static void freeDisplay(PDMode7_Display *display)
             releaseShader(display->ceilingShader);
         }
         
+        playdate->system->realloc(background->strip, 0);
+        playdate->system->realloc(background->stripMask, 0);
         playdate->system->realloc(background, 0);
         
         freeArray(display->visibleInstances);
+        freeArray(display->closeSprites);
         
         playdate->system->realloc(display, 0);
     }
@@ -2357,6 +4617,8 @@ static PDMode7_Camera* newCamera(void)
     camera->position = newVec3(0, 0, 0);
     
     camera->clipDistanceUnits = 1;
+    camera->farDistance = 0;
+    camera->version = 0;
     camera->isManaged = 0;
     camera->luaRef = NULL;
     
@@ -2373,6 +4635,7 @@ static void cameraSetPosition(PDMode7_Camera *camera, float x, float y, float z)
     camera->position.x = x;
     camera->position.y = y;
     camera->position.z = fmaxf(0, z);
+    camera->version++;
 }
 
 static float cameraGetAngle(PDMode7_Camera *camera)
@@ -2383,6 +4646,7 @@ static float cameraGetAngle(PDMode7_Camera *camera)
 static void cameraSetAngle(PDMode7_Camera *camera, float angle)
 {
     camera->angle = angle;
+    camera->version++;
 }
 
 static float cameraGetFOV(PDMode7_Camera *camera)
@@ -2393,6 +4657,7 @@ static float cameraGetFOV(PDMode7_Camera *camera)
 static void cameraSetFOV(PDMode7_Camera *camera, float fov)
 {
     camera->fov = fov;
+    camera->version++;
 }
 
 static float cameraGetPitch(PDMode7_Camera *camera)
@@ -2403,6 +4668,7 @@ static float cameraGetPitch(PDMode7_Camera *camera)
 static void cameraSetPitch(PDMode7_Camera *camera, float pitch)
 {
     camera->pitch = pitch;
+    camera->version++;
 }
 
 static int cameraGetClipDistanceUnits(PDMode7_Camera *camera)
@@ -2415,6 +4681,23 @@ static void cameraSetClipDistanceUnits(PDMode7_Camera *camera, int units)
     camera->clipDistanceUnits = units;
 }
 
+static float cameraGetFarDistance(PDMode7_Camera *camera)
+{
+    return camera->farDistance;
+}
+
+static void cameraSetFarDistance(PDMode7_Camera *camera, float distance)
+{
+    camera->farDistance = fmaxf(0, distance);
+    camera->version++;
+}
+
+static inline int cameraIsBeyondFarDistance(PDMode7_Camera *camera, float distance)
+{
+    // A far distance of 0 means no limit
+    return (camera->farDistance > 0 && distance > camera->farDistance);
+}
+
 static void cameraLookAtPoint(PDMode7_Camera *camera, PDMode7_Vec3 point)
 {
     PDMode7_Vec3 directionVec = vec3_subtract(point, camera->position);
@@ -2466,6 +4749,7 @@ static PDMode7_Sprite* newSprite(float width, float height, float depth)
         instance->luaBitmapTable = NULL;
         instance->bitmap = NULL;
         instance->drawCallback = NULL;
+        instance->bitmapTableWidth = 0;
         
         PDMode7_SpriteDataSource *dataSource = playdate->system->realloc(NULL, sizeof(PDMode7_SpriteDataSource));
         instance->dataSource = dataSource;
@@ -2489,6 +4773,8 @@ static PDMode7_Sprite* newSprite(float width, float height, float depth)
     }
     
     sprite->gridCells = newArray();
+    memset(&sprite->gridRange, 0, sizeof(_PDMode7_GridRange));
+    sprite->gridQuery = 0;
     sprite->luaRef = NULL;
     
     _PDMode7_LuaSpriteDataSource *luaDataSource = playdate->system->realloc(NULL, sizeof(_PDMode7_LuaSpriteDataSource));
@@ -2535,6 +4821,15 @@ static void spriteBoundsDidChange(PDMode7_Sprite *sprite)
     }
 }
 
+static void spriteExtentsDidChange(PDMode7_Sprite *sprite)
+{
+    PDMode7_World *world = sprite->world;
+    if(world)
+    {
+        gridIncludeSprite(world->grid, sprite);
+    }
+}
+
 static float spriteGetAngle(PDMode7_Sprite *sprite)
 {
     return sprite->angle;
@@ -2596,6 +4891,7 @@ static void _spriteSetImageCenter(PDMode7_SpriteInstance *instance, float cx, fl
 {
     instance->imageCenter.x = cx;
     instance->imageCenter.y = cy;
+    spriteExtentsDidChange(instance->sprite);
 }
 
 static void spriteSetImageCenter(PDMode7_Sprite *sprite, float cx, float cy)
@@ -2651,6 +4947,7 @@ static void _spriteSetBillboardSize(PDMode7_SpriteInstance *instance, float widt
 {
     instance->billboardSize.x = width;
     instance->billboardSize.y = height;
+    spriteExtentsDidChange(instance->sprite);
 }
 
 static void spriteSetBillboardSize(PDMode7_Sprite *sprite, float width, float height)
@@ -2670,6 +4967,7 @@ static void _spriteSetRoundingIncrement(PDMode7_SpriteInstance *instance, unsign
 {
     instance->roundingIncrement.x = x;
     instance->roundingIncrement.y = y;
+    spriteExtentsDidChange(instance->sprite);
 }
 
 static void spriteSetRoundingIncrement(PDMode7_Sprite *sprite, unsigned int x, unsigned int y)
@@ -2740,6 +5038,20 @@ static void _spriteSetBitmapTable(PDMode7_SpriteInstance *instance, LCDBitmapTab
     }
     instance->bitmapTable = bitmapTable;
     instance->luaBitmapTable = luaBitmapTable;
+    
+    // Widest bitmap in the table, used as a margin by grid queries
+    instance->bitmapTableWidth = 0;
+    if(bitmapTable)
+    {
+        LCDBitmap *bitmap;
+        for(int i = 0; (bitmap = playdate->graphics->getTableBitmap(bitmapTable, i)) != NULL; i++)
+        {
+            int bitmapWidth; int bitmapHeight;
+            playdate->graphics->getBitmapData(bitmap, &bitmapWidth, &bitmapHeight, NULL, NULL, NULL);
+            instance->bitmapTableWidth = mode7_max(instance->bitmapTableWidth, bitmapWidth);
+        }
+    }
+    spriteExtentsDidChange(instance->sprite);
 }
 
 static void _spriteSetBitmapTable_public(PDMode7_SpriteInstance *instance, LCDBitmapTable *bitmapTable)
@@ -3044,6 +5356,7 @@ static PDMode7_Shader newShader(PDMode7_ShaderType type, void *object)
     return (PDMode7_Shader){
         .objectType = type,
         .object = object,
+        .version = 0,
         .luaRef = NULL
     };
 }
@@ -3084,6 +5397,7 @@ static float linearShaderGetMinimumDistance(PDMode7_LinearShader *linear)
 static void linearShaderSetMinimumDistance(PDMode7_LinearShader *linear, float d)
 {
     linear->minDistance = d;
+    linear->shader.version++;
 }
 
 static float linearShaderGetMaximumDistance(PDMode7_LinearShader *linear)
@@ -3094,6 +5408,7 @@ static float linearShaderGetMaximumDistance(PDMode7_LinearShader *linear)
 static void linearShaderSetMaximumDistance(PDMode7_LinearShader *linear, float d)
 {
     linear->maxDistance = d;
+    linear->shader.version++;
 }
 
 static PDMode7_Color linearShaderGetColor(PDMode7_LinearShader *linear)
@@ -3104,6 +5419,7 @@ static PDMode7_Color linearShaderGetColor(PDMode7_LinearShader *linear)
 static void linearShaderSetColor(PDMode7_LinearShader *linear, PDMode7_Color color)
 {
     linear->color = color;
+    linear->shader.version++;
 }
 
 static int linearShaderGetInverted(PDMode7_LinearShader *linear)
@@ -3114,6 +5430,7 @@ static int linearShaderGetInverted(PDMode7_LinearShader *linear)
 static void linearShaderSetInverted(PDMode7_LinearShader *linear, int inverted)
 {
     linear->inverted = inverted;
+    linear->shader.version++;
 }
 
 static void freeLinearShader(PDMode7_LinearShader *linear)
@@ -3154,6 +5471,7 @@ static float radialShaderGetMinimumDistance(PDMode7_RadialShader *radial)
 static void radialShaderSetMinimumDistance(PDMode7_RadialShader *radial, float d)
 {
     radial->minDistance = d;
+    radial->shader.version++;
 }
 
 static float radialShaderGetMaximumDistance(PDMode7_RadialShader *radial)
@@ -3164,6 +5482,7 @@ static float radialShaderGetMaximumDistance(PDMode7_RadialShader *radial)
 static void radialShaderSetMaximumDistance(PDMode7_RadialShader *radial, float d)
 {
     radial->maxDistance = d;
+    radial->shader.version++;
 }
 
 static PDMode7_Color radialShaderGetColor(PDMode7_RadialShader *radial)
@@ -3174,6 +5493,7 @@ static PDMode7_Color radialShaderGetColor(PDMode7_RadialShader *radial)
 static void radialShaderSetColor(PDMode7_RadialShader *radial, PDMode7_Color color)
 {
     radial->color = color;
+    radial->shader.version++;
 }
 
 static PDMode7_Vec2 radialShaderGetOffset(PDMode7_RadialShader *radial)
@@ -3184,6 +5504,7 @@ static PDMode7_Vec2 radialShaderGetOffset(PDMode7_RadialShader *radial)
 static void radialShaderSetOffset(PDMode7_RadialShader *radial, float dx, float dy)
 {
     radial->offset = newVec2(dx, dy);
+    radial->shader.version++;
 }
 
 static int radialShaderGetInverted(PDMode7_RadialShader *radial)
@@ -3194,6 +5515,7 @@ static int radialShaderGetInverted(PDMode7_RadialShader *radial)
 static void radialShaderSetInverted(PDMode7_RadialShader *radial, int inverted)
 {
     radial->inverted = inverted;
+    radial->shader.version++;
 }
 
 static void freeRadialShader(PDMode7_RadialShader *radial)
@@ -3238,6 +5560,7 @@ static PDMode7_Tilemap* newTilemap(PDMode7_World *world, int tileWidth, int tile
     
     tilemap->fillBitmap = NULL;
     tilemap->fillBitmapScale_log = 0;
+    tilemap->version = 0;
     tilemap->luaRef = NULL;
     
     return tilemap;
@@ -3269,6 +5592,8 @@ static void tilemapSetBitmapAtIndex(PDMode7_Tilemap *tilemap, PDMode7_Bitmap *bi
         
         tile->bitmap = bitmap;
         tile->scale_log = log2_int(scale);
+        
+        tilemap->version++;
     }
 }
 
@@ -3338,6 +5663,8 @@ static void tilemapSetFillBitmap(PDMode7_Tilemap *tilemap, PDMode7_Bitmap *bitma
     
     tilemap->fillBitmap = bitmap;
     tilemap->fillBitmapScale_log = log2_int(scale);
+    
+    tilemap->version++;
 }
 
 static PDMode7_Bitmap* tilemapGetFillBitmap(PDMode7_Tilemap *tilemap)
@@ -3376,178 +5703,631 @@ static inline PDMode7_Rect newRect(int x, int y, int width, int height)
     };
 }
 
-static int rectIntersect(PDMode7_Rect rect1, PDMode7_Rect rect2)
+static int rectIntersect(PDMode7_Rect rect1, PDMode7_Rect rect2)
+{
+    return (rect1.x < (rect2.x + rect2.width) &&
+            rect2.x < (rect1.x + rect1.width) &&
+            rect1.y < (rect2.y + rect2.height) &&
+            rect2.y < (rect1.y + rect1.height));
+}
+
+static void rectAdjust(PDMode7_Rect rect, int width, int height, PDMode7_Rect *adjustedRect, int *offsetX, int *offsetY)
+{
+    int x1; int x2; int y1; int y2; *offsetX = 0; *offsetY = 0;
+    if(rect.x >= 0)
+    {
+        x1 = rect.x;
+    }
+    else
+    {
+        x1 = 0;
+        *offsetX = -rect.x;
+    }
+    if(rect.y >= 0)
+    {
+        y1 = rect.y;
+    }
+    else
+    {
+        y1 = 0;
+        *offsetY = -rect.y;
+    }
+    x2 = mode7_min(x1 - *offsetX + rect.width, width);
+    y2 = mode7_min(y1 - *offsetY + rect.height, height);
+    *adjustedRect = newRect(x1, y1, x2 - x1, y2 - y1);
+}
+
+static inline PDMode7_Vec3 newVec3(float x, float y, float z)
+{
+    return (PDMode7_Vec3){
+        .x = x,
+        .y = y,
+        .z = z
+    };
+}
+
+static inline PDMode7_Vec2 vec2FromVec3(PDMode7_Vec3 vec)
+{
+    return (PDMode7_Vec2){
+        .x = vec.x,
+        .y = vec.y
+    };
+}
+
+static inline PDMode7_Vec2 newVec2(float x, float y)
+{
+    return (PDMode7_Vec2){
+        .x = x,
+        .y = y
+    };
+}
+
+static inline PDMode7_Vec2ui newVec2ui(unsigned int x, unsigned int y)
+{
+    return (PDMode7_Vec2ui){
+        .x = x,
+        .y = y
+    };
+}
+
+static PDMode7_Vec3 vec3_subtract(PDMode7_Vec3 v1, PDMode7_Vec3 v2)
+{
+    return newVec3(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z);
+}
+
+static float vec3_dot(PDMode7_Vec3 v1, PDMode7_Vec3 v2)
+{
+    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+}
+
+static inline PDMode7_Color newGrayscaleColor(uint8_t gray, uint8_t alpha)
+{
+    return (PDMode7_Color){
+        .space = kPDMode7ColorSpaceGrayscale,
+        .gray = gray,
+        .alpha = alpha
+    };
+}
+
+static _PDMode7_Grid* newGrid(float width, float height, float depth, int cellSize, PDMode7_GridType type, int is2D)
+{
+    _PDMode7_Grid *grid = playdate->system->realloc(NULL, sizeof(_PDMode7_Grid));
+    
+    grid->type = type;
+    grid->is2D = is2D;
+    grid->cellSize = cellSize;
+    
+    grid->widthLen = ceilf(width / cellSize);
+    grid->heightLen = ceilf(height / cellSize);
+    grid->depthLen = ceilf(depth / cellSize);
+    
+    if(is2D)
+    {
+        // A single layer holds every sprite regardless of its z
+        grid->depthLen = 1;
+    }
+    
+    grid->numberOfCells = grid->widthLen * grid->heightLen * grid->depthLen;
+    
+    grid->spriteBounds = 0;
+    grid->spriteDepth = 0;
+    grid->spriteTop = 0;
+    grid->spriteWidth = 0;
+    grid->spritePixels = 0;
+    
+    grid->cellsVisited = 0;
+    grid->spritesVisited = 0;
+    
+    grid->freeCells = newArray();
+    
+    if(type == kMode7GridTypeSparse)
+    {
+        // Cells are allocated when a sprite is added to them
+        grid->cells = NULL;
+        grid->cellsCapacity = 0;
+        grid->cellsLength = 0;
+        gridResizeCells(grid, 64);
+    }
+    else
+    {
+        grid->cells = playdate->system->realloc(NULL, grid->numberOfCells * sizeof(_PDMode7_GridCell*));
+        grid->cellsCapacity = grid->numberOfCells;
+        grid->cellsLength = grid->numberOfCells;
+        
+        for(int i = 0; i < grid->numberOfCells; i++)
+        {
+            grid->cells[i] = newGridCell(i);
+        }
+    }
+    
+    return grid;
+}
+
+static _PDMode7_GridCell* newGridCell(int index)
+{
+    _PDMode7_GridCell *cell = playdate->system->realloc(NULL, sizeof(_PDMode7_GridCell));
+    cell->sprites = newArray();
+    cell->index = index;
+    return cell;
+}
+
+static unsigned int gridSlotFor(_PDMode7_Grid *grid, int index)
+{
+    unsigned int hash = (unsigned int)index * 2654435761u;
+    return (hash ^ (hash >> 16)) & (grid->cellsCapacity - 1);
+}
+
+static void gridResizeCells(_PDMode7_Grid *grid, int capacity)
+{
+    _PDMode7_GridCell **cells = grid->cells;
+    int oldCapacity = grid->cellsCapacity;
+    
+    grid->cells = playdate->system->realloc(NULL, capacity * sizeof(_PDMode7_GridCell*));
+    memset(grid->cells, 0, capacity * sizeof(_PDMode7_GridCell*));
+    grid->cellsCapacity = capacity;
+    
+    unsigned int mask = capacity - 1;
+    
+    for(int i = 0; i < oldCapacity; i++)
+    {
+        _PDMode7_GridCell *cell = cells[i];
+        if(cell)
+        {
+            unsigned int slot = gridSlotFor(grid, cell->index);
+            while(grid->cells[slot])
+            {
+                slot = (slot + 1) & mask;
+            }
+            grid->cells[slot] = cell;
+        }
+    }
+    
+    if(cells)
+    {
+        playdate->system->realloc(cells, 0);
+    }
+}
+
+static _PDMode7_GridCell* gridCellAt(_PDMode7_Grid *grid, int index)
 {
-    return (rect1.x < (rect2.x + rect2.width) &&
-            rect2.x < (rect1.x + rect1.width) &&
-            rect1.y < (rect2.y + rect2.height) &&
-            rect2.y < (rect1.y + rect1.height));
+    if(grid->type != kMode7GridTypeSparse)
+    {
+        return grid->cells[index];
+    }
+    
+    // Open addressing with linear probing, the table always has empty slots
+    unsigned int mask = grid->cellsCapacity - 1;
+    for(unsigned int slot = gridSlotFor(grid, index); grid->cells[slot]; slot = (slot + 1) & mask)
+    {
+        if(grid->cells[slot]->index == index)
+        {
+            return grid->cells[slot];
+        }
+    }
+    
+    return NULL;
 }
 
-static void rectAdjust(PDMode7_Rect rect, int width, int height, PDMode7_Rect *adjustedRect, int *offsetX, int *offsetY)
+static _PDMode7_GridCell* gridInsertCell(_PDMode7_Grid *grid, int index)
 {
-    int x1; int x2; int y1; int y2; *offsetX = 0; *offsetY = 0;
-    if(rect.x >= 0)
+    _PDMode7_GridCell *cell = gridCellAt(grid, index);
+    if(cell)
     {
-        x1 = rect.x;
+        return cell;
     }
-    else
+    
+    // Load factor is kept at 1/2 or less
+    if((grid->cellsLength + 1) * 2 > grid->cellsCapacity)
     {
-        x1 = 0;
-        *offsetX = -rect.x;
+        gridResizeCells(grid, grid->cellsCapacity * 2);
     }
-    if(rect.y >= 0)
+    
+    // Empty cells are recycled, sprites moving between cells don't allocate
+    if(grid->freeCells->length > 0)
     {
-        y1 = rect.y;
+        cell = grid->freeCells->items[grid->freeCells->length - 1];
+        arraySwapRemove(grid->freeCells, grid->freeCells->length - 1);
+        cell->index = index;
     }
     else
     {
-        y1 = 0;
-        *offsetY = -rect.y;
+        cell = newGridCell(index);
     }
-    x2 = mode7_min(x1 - *offsetX + rect.width, width);
-    y2 = mode7_min(y1 - *offsetY + rect.height, height);
-    *adjustedRect = newRect(x1, y1, x2 - x1, y2 - y1);
+    
+    unsigned int mask = grid->cellsCapacity - 1;
+    unsigned int slot = gridSlotFor(grid, index);
+    while(grid->cells[slot])
+    {
+        slot = (slot + 1) & mask;
+    }
+    grid->cells[slot] = cell;
+    grid->cellsLength++;
+    
+    return cell;
 }
 
-static inline PDMode7_Vec3 newVec3(float x, float y, float z)
+static void gridReleaseCell(_PDMode7_Grid *grid, _PDMode7_GridCell *cell)
 {
-    return (PDMode7_Vec3){
-        .x = x,
-        .y = y,
-        .z = z
-    };
+    if(grid->type != kMode7GridTypeSparse || cell->sprites->length > 0)
+    {
+        return;
+    }
+    
+    unsigned int mask = grid->cellsCapacity - 1;
+    unsigned int slot = gridSlotFor(grid, cell->index);
+    while(grid->cells[slot] != cell)
+    {
+        slot = (slot + 1) & mask;
+    }
+    
+    // Backward shift deletion, entries after the hole are moved back if their probe sequence crosses it
+    unsigned int hole = slot;
+    grid->cells[hole] = NULL;
+    
+    for(slot = (hole + 1) & mask; grid->cells[slot]; slot = (slot + 1) & mask)
+    {
+        unsigned int home = gridSlotFor(grid, grid->cells[slot]->index);
+        if(((slot - home) & mask) >= ((slot - hole) & mask))
+        {
+            grid->cells[hole] = grid->cells[slot];
+            grid->cells[slot] = NULL;
+            hole = slot;
+        }
+    }
+    
+    grid->cellsLength--;
+    arrayPush(grid->freeCells, cell);
 }
 
-static inline PDMode7_Vec2 vec2FromVec3(PDMode7_Vec3 vec)
+static int gridIndexAtX(_PDMode7_Grid *grid, float x)
 {
-    return (PDMode7_Vec2){
-        .x = vec.x,
-        .y = vec.y
-    };
+    return fmaxf(0, fminf(floorf(x / grid->cellSize), grid->widthLen - 1));
 }
 
-static inline PDMode7_Vec2 newVec2(float x, float y)
+static int gridIndexAtY(_PDMode7_Grid *grid, float y)
 {
-    return (PDMode7_Vec2){
-        .x = x,
-        .y = y
-    };
+    return fmaxf(0, fminf(floorf(y / grid->cellSize), grid->heightLen - 1));
 }
 
-static inline PDMode7_Vec2ui newVec2ui(unsigned int x, unsigned int y)
+static int gridIndexAtZ(_PDMode7_Grid *grid, float z)
 {
-    return (PDMode7_Vec2ui){
-        .x = x,
-        .y = y
-    };
+    return fmaxf(0, fminf(floorf(z / grid->cellSize), grid->depthLen - 1));
 }
 
-static PDMode7_Vec3 vec3_subtract(PDMode7_Vec3 v1, PDMode7_Vec3 v2)
+static int gridIndexFor(_PDMode7_Grid *grid, int widthIndex, int heightIndex, int depthIndex)
 {
-    return newVec3(v1.x - v2.x, v1.y - v2.y, v1.z - v2.z);
+    if(grid->is2D)
+    {
+        return heightIndex * grid->widthLen + widthIndex;
+    }
+    return (depthIndex * grid->heightLen + heightIndex) * grid->widthLen + widthIndex;
 }
 
-static float vec3_dot(PDMode7_Vec3 v1, PDMode7_Vec3 v2)
+static _PDMode7_GridRange gridRangeAtPoint(_PDMode7_Grid *grid, PDMode7_Vec3 point, int distanceUnits)
 {
-    return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+    _PDMode7_GridRange range;
+    
+    int midX = gridIndexAtX(grid, point.x);
+    range.startX = fmaxf(midX - distanceUnits, 0);
+    range.endX = fminf(midX + distanceUnits, grid->widthLen - 1);
+    
+    int midY = gridIndexAtY(grid, point.y);
+    range.startY = fmaxf(midY - distanceUnits, 0);
+    range.endY = fminf(midY + distanceUnits, grid->heightLen - 1);
+    
+    int midZ = gridIndexAtZ(grid, point.z);
+    range.startZ = fmaxf(midZ - distanceUnits, 0);
+    range.endZ = fminf(midZ + distanceUnits, grid->depthLen - 1);
+    
+    return range;
 }
 
-static inline PDMode7_Color newGrayscaleColor(uint8_t gray, uint8_t alpha)
+static int gridRangeIntersects(_PDMode7_GridRange *rangeA, _PDMode7_GridRange *rangeB)
 {
-    return (PDMode7_Color){
-        .space = kPDMode7ColorSpaceGrayscale,
-        .gray = gray,
-        .alpha = alpha
-    };
+    return (rangeA->startX <= rangeB->endX && rangeB->startX <= rangeA->endX && rangeA->startY <= rangeB->endY && rangeB->startY <= rangeA->endY && rangeA->startZ <= rangeB->endZ && rangeB->startZ <= rangeA->endZ);
 }
 
-static _PDMode7_Grid* newGrid(float width, float height, float depth, int cellSize)
+static _PDMode7_GridRange gridRangeUnion(_PDMode7_GridRange *rangeA, _PDMode7_GridRange *rangeB)
 {
-    _PDMode7_Grid *grid = playdate->system->realloc(NULL, sizeof(_PDMode7_Grid));
+    _PDMode7_GridRange range;
+    range.startX = mode7_min(rangeA->startX, rangeB->startX);
+    range.endX = mode7_max(rangeA->endX, rangeB->endX);
+    range.startY = mode7_min(rangeA->startY, rangeB->startY);
+    range.endY = mode7_max(rangeA->endY, rangeB->endY);
+    range.startZ = mode7_min(rangeA->startZ, rangeB->startZ);
+    range.endZ = mode7_max(rangeA->endZ, rangeB->endZ);
+    return range;
+}
+
+static _PDMode7_GridView gridViewForDisplay(_PDMode7_Grid *grid, PDMode7_Display *display, _PDMode7_Parameters *p)
+{
+    PDMode7_Camera *camera = display->camera;
     
-    grid->cellSize = cellSize;
+    _PDMode7_GridView view;
+    memset(&view, 0, sizeof(_PDMode7_GridView));
     
-    grid->widthLen = ceilf(width / cellSize);
-    grid->heightLen = ceilf(height / cellSize);
-    grid->depthLen = ceilf(depth / cellSize);
+    view.range = gridRangeAtPoint(grid, camera->position, camera->clipDistanceUnits);
     
-    grid->numberOfCells = grid->widthLen * grid->heightLen * grid->depthLen;
-    grid->cells = playdate->system->realloc(NULL, grid->numberOfCells * sizeof(_PDMode7_GridCell*));
+    // A sprite can be registered in cells away from its center
+    view.margin = grid->spriteBounds;
     
-    for(int i = 0; i < grid->numberOfCells; i++)
+    if(display->rect.width <= 0)
     {
-        _PDMode7_GridCell *cell = playdate->system->realloc(NULL, sizeof(_PDMode7_GridCell));
-        cell->sprites = newArray();
-        grid->cells[i] = cell;
+        return view;
     }
     
-    return grid;
+    // A sprite is visible only if |localX| <= localZ * scale + spriteWidth
+    // The scale includes the pixel extents of the sprite rect
+    float scale = p->tanHalfFov.x * (1 + 2 * grid->spritePixels / display->rect.width);
+    
+    // localZ = cos(pitch) * (forward · v) + sin(pitch) * dz
+    float cosPitch = cosf(camera->pitch);
+    float sinPitch = sinf(camera->pitch);
+    
+    float slope = scale * cosPitch;
+    if(!isfinite(slope) || slope < 0.0001f)
+    {
+        // Looking straight up or down, the wedge covers the whole range
+        return view;
+    }
+    
+    float minZ = view.range.startZ * grid->cellSize - grid->spriteDepth - camera->position.z;
+    float maxZ = (view.range.endZ + 1) * grid->cellSize;
+    if(view.range.endZ == grid->depthLen - 1)
+    {
+        // Sprites above the grid are clamped to the top cells
+        maxZ = fmaxf(maxZ, grid->spriteTop);
+    }
+    maxZ += grid->spriteDepth - camera->position.z;
+    
+    float offset = scale * fmaxf(sinPitch * minZ, sinPitch * maxZ) + grid->spriteWidth;
+    
+    PDMode7_Vec2 forward = newVec2(cosf(camera->angle), sinf(camera->angle));
+    PDMode7_Vec2 right = newVec2(-forward.y, forward.x);
+    
+    // Left and right sides of the horizontal wedge: ±(right · v) - slope * (forward · v) <= offset
+    for(int i = 0; i < 2; i++)
+    {
+        float sign = (i == 0) ? 1 : -1;
+        PDMode7_Vec2 normal = newVec2(sign * right.x - slope * forward.x, sign * right.y - slope * forward.y);
+        view.normals[i] = normal;
+        view.limits[i] = offset + normal.x * camera->position.x + normal.y * camera->position.y;
+    }
+    view.numberOfPlanes = 2;
+    
+    return view;
 }
 
-static int gridIndexAtX(_PDMode7_Grid *grid, float x)
+static int gridViewRowsAtColumn(_PDMode7_Grid *grid, _PDMode7_GridView *view, int x, int *startY, int *endY)
 {
-    return fmaxf(0, fminf(floorf(x / grid->cellSize), grid->widthLen - 1));
+    if(x < view->range.startX || x > view->range.endX)
+    {
+        return 0;
+    }
+    
+    float cellSize = grid->cellSize;
+    
+    // Sprites outside the grid are clamped to the edge cells, these cells extend to infinity
+    float columnStart = (x > 0) ? (x * cellSize - view->margin) : -INFINITY;
+    float columnEnd = (x < grid->widthLen - 1) ? ((x + 1) * cellSize + view->margin) : INFINITY;
+    
+    float minY = view->range.startY;
+    float maxY = view->range.endY;
+    
+    for(int i = 0; i < view->numberOfPlanes; i++)
+    {
+        PDMode7_Vec2 normal = view->normals[i];
+        
+        // Solve normal · (x, y) <= limit for the nearest point of each cell
+        float nearestX = 0;
+        if(normal.x > 0)
+        {
+            nearestX = normal.x * columnStart;
+        }
+        else if(normal.x < 0)
+        {
+            nearestX = normal.x * columnEnd;
+        }
+        
+        if(!isfinite(nearestX))
+        {
+            continue;
+        }
+        
+        float limit = view->limits[i] - nearestX;
+        if(normal.y > 0)
+        {
+            float y = floorf((limit / normal.y + view->margin) / cellSize);
+            maxY = fminf(maxY, fmaxf(y, 0));
+        }
+        else if(normal.y < 0)
+        {
+            float y = ceilf((limit / normal.y - view->margin) / cellSize - 1);
+            minY = fmaxf(minY, fminf(y, grid->heightLen - 1));
+        }
+        else if(limit < 0)
+        {
+            return 0;
+        }
+    }
+    
+    if(minY > maxY)
+    {
+        return 0;
+    }
+    
+    *startY = minY;
+    *endY = maxY;
+    
+    return 1;
 }
 
-static int gridIndexAtY(_PDMode7_Grid *grid, float y)
+static int gridViewsColumn(_PDMode7_Grid *grid, _PDMode7_GridView **views, int numberOfViews, int x, _PDMode7_GridRange *column)
 {
-    return fmaxf(0, fminf(floorf(y / grid->cellSize), grid->heightLen - 1));
+    int found = 0;
+    
+    for(int i = 0; i < numberOfViews; i++)
+    {
+        _PDMode7_GridView *view = views[i];
+        int startY; int endY;
+        if(gridViewRowsAtColumn(grid, view, x, &startY, &endY))
+        {
+            if(!found)
+            {
+                *column = (_PDMode7_GridRange){
+                    .startX = x,
+                    .endX = x,
+                    .startY = startY,
+                    .endY = endY,
+                    .startZ = view->range.startZ,
+                    .endZ = view->range.endZ
+                };
+                found = 1;
+            }
+            else
+            {
+                // Merged views use the hull of their rows
+                column->startY = mode7_min(column->startY, startY);
+                column->endY = mode7_max(column->endY, endY);
+                column->startZ = mode7_min(column->startZ, view->range.startZ);
+                column->endZ = mode7_max(column->endZ, view->range.endZ);
+            }
+        }
+    }
+    
+    return found;
 }
 
-static int gridIndexAtZ(_PDMode7_Grid *grid, float z)
+static void gridViewsRangeX(_PDMode7_GridView **views, int numberOfViews, int *startX, int *endX)
 {
-    return fmaxf(0, fminf(floorf(z / grid->cellSize), grid->depthLen - 1));
+    *startX = views[0]->range.startX;
+    *endX = views[0]->range.endX;
+    
+    for(int i = 1; i < numberOfViews; i++)
+    {
+        *startX = mode7_min(*startX, views[i]->range.startX);
+        *endX = mode7_max(*endX, views[i]->range.endX);
+    }
 }
 
-static int gridIndexFor(_PDMode7_Grid *grid, int widthIndex, int heightIndex, int depthIndex)
+static int gridViewsCellCount(_PDMode7_Grid *grid, _PDMode7_GridView **views, int numberOfViews)
 {
-    return depthIndex * (grid->widthLen * grid->heightLen) + widthIndex * grid->widthLen + heightIndex;
+    int startX; int endX;
+    gridViewsRangeX(views, numberOfViews, &startX, &endX);
+    
+    int count = 0;
+    
+    for(int x = startX; x <= endX; x++)
+    {
+        _PDMode7_GridRange column;
+        if(gridViewsColumn(grid, views, numberOfViews, x, &column))
+        {
+            count += (column.endY - column.startY + 1) * (column.endZ - column.startZ + 1);
+        }
+    }
+    
+    return count;
 }
 
-static _PDMode7_Array* gridGetSpritesAtPoint(_PDMode7_Grid *grid, PDMode7_Vec3 point, int distanceUnits)
+static int gridViewIntersectsRange(_PDMode7_Grid *grid, _PDMode7_GridView *view, _PDMode7_GridRange *range)
 {
-    _PDMode7_Array *results = newArray();
+    if(range->startZ > view->range.endZ || range->endZ < view->range.startZ)
+    {
+        return 0;
+    }
+    
+    int startX = mode7_max(range->startX, view->range.startX);
+    int endX = mode7_min(range->endX, view->range.endX);
+    
+    for(int x = startX; x <= endX; x++)
+    {
+        int startY; int endY;
+        if(gridViewRowsAtColumn(grid, view, x, &startY, &endY) && range->startY <= endY && startY <= range->endY)
+        {
+            return 1;
+        }
+    }
+    
+    return 0;
+}
 
-    int midX = gridIndexAtY(grid, point.x);
-    int startX = fmaxf(midX - distanceUnits, 0);
-    int endX = fminf(midX + distanceUnits, grid->widthLen - 1);
+static void gridGetSpritesInViews(_PDMode7_Grid *grid, _PDMode7_GridView **views, int numberOfViews, _PDMode7_Array *results)
+{
+    arrayClear(results);
     
-    int midY = gridIndexAtY(grid, point.y);
-    int startY = fmaxf(midY - distanceUnits, 0);
-    int endY = fminf(midY + distanceUnits, grid->heightLen - 1);
+    // Sprites in more than one cell are collected once
+    if(++gridQuery == 0)
+    {
+        gridQuery = 1;
+    }
     
-    int midZ = gridIndexAtZ(grid, point.z);
-    int startZ = fmaxf(midZ - distanceUnits, 0);
-    int endZ = fminf(midZ + distanceUnits, grid->depthLen - 1);
+    int startX; int endX;
+    gridViewsRangeX(views, numberOfViews, &startX, &endX);
     
-    for(int z = startZ; z <= endZ; z++)
+    for(int x = startX; x <= endX; x++)
     {
-        for(int x = startX; x <= endX; x++)
+        _PDMode7_GridRange column;
+        if(!gridViewsColumn(grid, views, numberOfViews, x, &column))
         {
-            for(int y = startY; y <= endY; y++)
+            continue;
+        }
+        
+        for(int z = column.startZ; z <= column.endZ; z++)
+        {
+            for(int y = column.startY; y <= column.endY; y++)
             {
                 int cellIndex = gridIndexFor(grid, x, y, z);
-                _PDMode7_GridCell *cell = grid->cells[cellIndex];
+                _PDMode7_GridCell *cell = gridCellAt(grid, cellIndex);
+                
+                grid->cellsVisited++;
+                if(!cell)
+                {
+                    continue;
+                }
+                
+                grid->spritesVisited += cell->sprites->length;
                 
                 for(int i = 0; i < cell->sprites->length; i++)
                 {
                     PDMode7_Sprite *sprite = cell->sprites->items[i];
-                    if(arrayIndexOf(results, sprite) < 0)
+                    if(sprite->gridQuery != gridQuery)
                     {
+                        sprite->gridQuery = gridQuery;
                         arrayPush(results, sprite);
                     }
                 }
             }
         }
     }
+}
+
+static void gridIncludeSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite)
+{
+    // Extents only grow, view margins stay valid for every sprite in the grid
+    grid->spriteBounds = fmaxf(grid->spriteBounds, (fabsf(sprite->size.x) + fabsf(sprite->size.y)) * 0.5f);
+    grid->spriteDepth = fmaxf(grid->spriteDepth, fabsf(sprite->size.z) * 0.5f);
+    grid->spriteTop = fmaxf(grid->spriteTop, sprite->position.z);
     
-    return results;
+    for(int i = 0; i < MODE7_MAX_DISPLAYS; i++)
+    {
+        PDMode7_SpriteInstance *instance = sprite->instances[i];
+        
+        // Farthest side of the sprite rect from the image center, relative to its width
+        float side = fmaxf(fabsf(instance->imageCenter.x), fabsf(1 - instance->imageCenter.x));
+        
+        float width = fmaxf(fmaxf(fabsf(sprite->size.x), fabsf(sprite->size.y)), fabsf(instance->billboardSize.x));
+        grid->spriteWidth = fmaxf(grid->spriteWidth, width * side);
+        
+        // Rounding and alignment move the rect by a few pixels
+        float pixels = (instance->bitmapTableWidth + 1) * side + instance->roundingIncrement.x + 2;
+        grid->spritePixels = fmaxf(grid->spritePixels, pixels);
+    }
 }
 
 static void gridUpdateSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite)
 {
     gridRemoveSprite(grid, sprite);
+    gridIncludeSprite(grid, sprite);
     
     float boundsWidth = fabsf(sprite->size.x * cosf(sprite->angle)) + fabsf(sprite->size.y * sinf(sprite->angle));
     float boundsHeight = fabsf(sprite->size.x * sinf(sprite->angle)) + fabsf(sprite->size.y * cosf(sprite->angle));
@@ -3560,6 +6340,16 @@ static void gridUpdateSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite)
     
     int startZ = gridIndexAtZ(grid, sprite->position.z - sprite->size.z * 0.5f);
     int endZ = gridIndexAtZ(grid, sprite->position.z + sprite->size.z * 0.5f);
+    
+    // Cells are contiguous, a query range contains the sprite if it intersects this range
+    sprite->gridRange = (_PDMode7_GridRange){
+        .startX = startX,
+        .endX = endX,
+        .startY = startY,
+        .endY = endY,
+        .startZ = startZ,
+        .endZ = endZ
+    };
 
     for(int z = startZ; z <= endZ; z++)
     {
@@ -3568,7 +6358,7 @@ static void gridUpdateSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite)
             for(int y = startY; y <= endY; y++)
             {
                 int cellIndex = gridIndexFor(grid, x, y, z);
-                _PDMode7_GridCell *cell = grid->cells[cellIndex];
+                _PDMode7_GridCell *cell = gridInsertCell(grid, cellIndex);
                                 
                 arrayPush(cell->sprites, sprite);
                 arrayPush(sprite->gridCells, cell);
@@ -3585,22 +6375,37 @@ static void gridRemoveSprite(_PDMode7_Grid *grid, PDMode7_Sprite *sprite)
         int index = arrayIndexOf(cell->sprites, sprite);
         if(index >= 0)
         {
-            arrayRemove(cell->sprites, index);
+            arraySwapRemove(cell->sprites, index);
         }
+        gridReleaseCell(grid, cell);
     }
     
     arrayClear(sprite->gridCells);
 }
 
+static void freeGridCell(_PDMode7_GridCell *cell)
+{
+    freeArray(cell->sprites);
+    playdate->system->realloc(cell, 0);
+}
+
 static void freeGrid(_PDMode7_Grid *grid)
 {
-    for(int i = 0; i < grid->numberOfCells; i++)
+    for(int i = 0; i < grid->cellsCapacity; i++)
     {
         _PDMode7_GridCell *cell = grid->cells[i];
-        freeArray(cell->sprites);
-        playdate->system->realloc(cell, 0);
+        if(cell)
+        {
+            freeGridCell(cell);
+        }
+    }
+    
+    for(int i = 0; i < grid->freeCells->length; i++)
+    {
+        freeGridCell(grid->freeCells->items[i]);
     }
     
+    freeArray(grid->freeCells);
     playdate->system->realloc(grid->cells, 0);
     playdate->system->realloc(grid, 0);
 }
@@ -3611,29 +6416,46 @@ static _PDMode7_Array* newArray(void)
     
     array->items = NULL;
     array->length = 0;
+    array->capacity = 0;
     
     return array;
 }
 
+static void arrayReserve(_PDMode7_Array *array, int capacity)
+{
+    if(capacity > array->capacity)
+    {
+        array->items = playdate->system->realloc(array->items, capacity * sizeof(void*));
+        array->capacity = capacity;
+    }
+}
+
 static void arrayPush(_PDMode7_Array *array, void *item)
 {
-    array->length++;
-    array->items = playdate->system->realloc(array->items, array->length * sizeof(void*));
-    array->items[array->length - 1] = item;
+    if(array->length == array->capacity)
+    {
+        // Capacity grows geometrically, pushes don't reallocate most of the time
+        arrayReserve(array, array->capacity > 0 ? (array->capacity * 2) : 4);
+    }
+    array->items[array->length++] = item;
 }
 
 static void arrayRemove(_PDMode7_Array *array, int index)
 {
     if(index >= 0 && index < array->length)
     {
-        for(int i = index; i < (array->length - 1); i++)
-        {
-            array->items[i] = array->items[i + 1];
-        }
-        
+        memmove(array->items + index, array->items + index + 1, (array->length - index - 1) * sizeof(void*));
+        array->length--;
+    }
+}
+
+static void arraySwapRemove(_PDMode7_Array *array, int index)
+{
+    // The last item takes the place of the removed one, for arrays where order doesn't matter
+    if(index >= 0 && index < array->length)
+    {
+        array->items[index] = array->items[array->length - 1];
         array->length--;
-        
-        array->items = playdate->system->realloc(array->items, array->length * sizeof(void*));
     }
 }
 
@@ -3652,11 +6474,7 @@ static int arrayIndexOf(_PDMode7_Array *array, void *item)
 
 static void arrayClear(_PDMode7_Array *array)
 {
-    if(array->items)
-    {
-        playdate->system->realloc(array->items, 0);
-    }
-    array->items = NULL;
+    // Capacity is kept for the next pushes
     array->length = 0;
 }
 
@@ -3818,7 +6636,7 @@ static void GC_release(LuaUDObject *luaRef)
         if(ref->count <= 0)
         {
             playdate->lua->releaseObject(ref->luaRef);
-            arrayRemove(gc->references, index);
+            arraySwapRemove(gc->references, index);
             freeGCRef(ref);
         }
     }
@@ -3829,12 +6647,14 @@ static _PDMode7_Pool* newPool(void)
     _PDMode7_Pool *pool = playdate->system->realloc(NULL, sizeof(_PDMode7_Pool));
     pool->ptr = NULL;
     pool->originalPtr = NULL;
+    pool->size = 0;
     return pool;
 }
 
 static void poolRealloc(_PDMode7_Pool *pool, size_t size)
 {
     pool->originalPtr = playdate->system->realloc(pool->originalPtr, size);
+    pool->size = size;
     if(!pool->ptr)
     {
         pool->ptr = pool->originalPtr;
@@ -3853,7 +6673,19 @@ static void poolClear(_PDMode7_Pool *pool)
 
 static void poolClear_public(void)
 {
-    poolClear(pool);
+    poolClear(pool);
+}
+
+static void* poolAlloc(_PDMode7_Pool *pool, size_t size)
+{
+    // Returns NULL if the pool has no room left
+    if(!pool->ptr || (size_t)(pool->ptr - pool->originalPtr) + size > pool->size)
+    {
+        return NULL;
+    }
+    void *ptr = pool->ptr;
+    pool->ptr += size;
+    return ptr;
 }
 
 static int log2_int(uint32_t n)
@@ -3945,8 +6777,16 @@ static PDMode7_Bitmap* newBaseBitmap(void)
     bitmap->data = NULL;
     bitmap->mask = NULL;
     bitmap->layers = newArray();
+    bitmap->mipLevels = 0;
+    bitmap->mipData = NULL;
+    bitmap->layout = kMode7BitmapLayoutLinear;
+    bitmap->blockColumns = 0;
+    bitmap->version = 0;
+    bitmap->dirtyRect = newRect(0, 0, 0, 0);
+    bitmap->dirtyVersion = 0;
     bitmap->isManaged = 0;
     bitmap->freeData = 0;
+    bitmap->freeMipData = 0;
     bitmap->luaRef = NULL;
 
     return bitmap;
@@ -3984,14 +6824,80 @@ static PDMode7_Bitmap* newBitmap(int width, int height, PDMode7_Color bgColor)
     return bitmap;
 }
 
+static size_t bitmapDataSize(PDMode7_Bitmap *bitmap)
+{
+    if(bitmap->layout == kMode7BitmapLayoutTiled)
+    {
+        int rows = (bitmap->height + (1 << MODE7_BITMAP_BLOCK_LOG) - 1) >> MODE7_BITMAP_BLOCK_LOG;
+        return (size_t)(bitmap->blockColumns * rows) << (MODE7_BITMAP_BLOCK_LOG * 2);
+    }
+    return bitmap->width * bitmap->height;
+}
+
+static inline int bitmapRowRun(PDMode7_Bitmap *bitmap, int x, int length)
+{
+    // Contiguous texels starting at x, a tiled row is contiguous up to the block edge
+    if(bitmap->layout == kMode7BitmapLayoutTiled)
+    {
+        const int blockSize = 1 << MODE7_BITMAP_BLOCK_LOG;
+        return mode7_min(length, blockSize - (x & (blockSize - 1)));
+    }
+    return length;
+}
+
+static void bitmapReadRow(PDMode7_Bitmap *bitmap, int x, int y, int length, uint8_t *out)
+{
+    while(length > 0)
+    {
+        int run = bitmapRowRun(bitmap, x, length);
+        memcpy(out, bitmap->data + bitmapOffset(bitmap, x, y), run);
+        out += run;
+        x += run;
+        length -= run;
+    }
+}
+
+static void bitmapWriteRow(PDMode7_Bitmap *bitmap, int x, int y, int length, const uint8_t *in)
+{
+    while(length > 0)
+    {
+        int run = bitmapRowRun(bitmap, x, length);
+        memcpy(bitmap->data + bitmapOffset(bitmap, x, y), in, run);
+        in += run;
+        x += run;
+        length -= run;
+    }
+}
+
+static void bitmapCopyRow(PDMode7_Bitmap *src, int srcX, int srcY, PDMode7_Bitmap *dst, int dstX, int dstY, int length)
+{
+    if(src->layout == kMode7BitmapLayoutLinear)
+    {
+        bitmapWriteRow(dst, dstX, dstY, length, src->data + srcY * src->width + srcX);
+    }
+    else if(dst->layout == kMode7BitmapLayoutLinear)
+    {
+        bitmapReadRow(src, srcX, srcY, length, dst->data + dstY * dst->width + dstX);
+    }
+    else
+    {
+        for(int i = 0; i < length; i++)
+        {
+            dst->data[bitmapOffset(dst, dstX + i, dstY)] = src->data[bitmapOffset(src, srcX + i, srcY)];
+        }
+    }
+}
+
 static PDMode7_Bitmap* copyBitmap(PDMode7_Bitmap *src)
 {
     PDMode7_Bitmap *dst = newBaseBitmap();
     
     dst->width = src->width;
     dst->height = src->height;
+    dst->layout = src->layout;
+    dst->blockColumns = src->blockColumns;
     
-    size_t dataLen = src->width * src->height;
+    size_t dataLen = bitmapDataSize(src);
     
     dst->data = playdate->system->realloc(NULL, dataLen);
     memcpy(dst->data, src->data, dataLen);
@@ -4003,8 +6909,10 @@ static PDMode7_Bitmap* copyBitmap(PDMode7_Bitmap *src)
         
         mask->width = src->mask->width;
         mask->height = src->mask->height;
+        mask->layout = src->mask->layout;
+        mask->blockColumns = src->mask->blockColumns;
         
-        size_t maskLen = src->mask->width * src->mask->height;
+        size_t maskLen = bitmapDataSize(src->mask);
         
         mask->data = playdate->system->realloc(NULL, maskLen);
         memcpy(mask->data, src->mask->data, maskLen);
@@ -4015,6 +6923,11 @@ static PDMode7_Bitmap* copyBitmap(PDMode7_Bitmap *src)
         dst->mask = mask;
     }
     
+    if(src->mipLevels > 0)
+    {
+        bitmapGenerateMipmaps(dst);
+    }
+    
     return dst;
 }
 
@@ -4085,13 +6998,12 @@ static PDMode7_Color bitmapColorAt(PDMode7_Bitmap *bitmap, int x, int y)
 {
     if(x >= 0 && x < bitmap->width && y >= 0 && y < bitmap->height)
     {
-        int i = y * bitmap->width + x;
-        uint8_t gray = bitmap->data[i];
+        uint8_t gray = bitmap->data[bitmapOffset(bitmap, x, y)];
         uint8_t alpha = 255;
         
         if(bitmap->mask)
         {
-            alpha = bitmap->mask->data[i];
+            alpha = bitmap->mask->data[bitmapOffset(bitmap->mask, x, y)];
         }
         
         return newGrayscaleColor(gray, alpha);
@@ -4157,21 +7069,21 @@ static void bitmapDrawInto(PDMode7_Bitmap *bitmap, PDMode7_Bitmap *target, int b
     {
         int src_y = offsetY + y;
         int dst_y = adjustedRect.y + y;
-        int src_rows = src_y * bitmap->width + offsetX;
-        int dst_rows = dst_y * target->width + adjustedRect.x;
         
         if(bitmap->mask || target->mask)
         {
             for(int x = 0; x < adjustedRect.width; x++)
             {
-                int src_offset = src_rows + x;
-                int dst_offset = dst_rows + x;
+                int src_x = offsetX + x;
+                int dst_x = adjustedRect.x + x;
+                int src_offset = bitmapOffset(bitmap, src_x, src_y);
+                int dst_offset = bitmapOffset(target, dst_x, dst_y);
                 
                 uint8_t color = bitmap->data[src_offset];
                 uint8_t backgroundColor = target->data[dst_offset];
                 
-                uint8_t alpha = bitmap->mask ? bitmap->mask->data[src_offset] : 255;
-                uint8_t backgroundAlpha = target->mask ? target->mask->data[dst_offset] : 255;
+                uint8_t alpha = bitmap->mask ? bitmap->mask->data[bitmapOffset(bitmap->mask, src_x, src_y)] : 255;
+                uint8_t backgroundAlpha = target->mask ? target->mask->data[bitmapOffset(target->mask, dst_x, dst_y)] : 255;
                 
                 uint8_t alphaOut = alpha + (unsigned int)(backgroundAlpha * (255 - alpha) + 127) / 255;
                 uint8_t colorOut = (alphaOut != 0) ? (color * alpha + backgroundColor * backgroundAlpha * (uint8_t)(255 - alpha) / 255 + alphaOut / 2) / alphaOut : 0;
@@ -4179,15 +7091,17 @@ static void bitmapDrawInto(PDMode7_Bitmap *bitmap, PDMode7_Bitmap *target, int b
                 target->data[dst_offset] = colorOut;
                 if(target->mask)
                 {
-                    target->mask->data[dst_offset] = alphaOut;
+                    target->mask->data[bitmapOffset(target->mask, dst_x, dst_y)] = alphaOut;
                 }
             }
         }
         else
         {
-            memcpy(target->data + dst_rows, bitmap->data + src_rows, adjustedRect.width);
+            bitmapCopyRow(bitmap, offsetX, src_y, target, adjustedRect.x, dst_y, adjustedRect.width);
         }
     }
+    
+    bitmapDidChange(target, adjustedRect);
 }
 
 static void bitmapAddLayer(PDMode7_Bitmap *bitmap, PDMode7_BitmapLayer *layer)
@@ -4232,6 +7146,230 @@ static void bitmapRemoveAllLayers(PDMode7_Bitmap *bitmap)
     }
 }
 
+static void mipDownsample(const uint8_t *src, int srcWidth, int srcHeight, int srcColumns, _PDMode7_MipLevel *dst, int x0, int y0, int x1, int y1)
+{
+    // 2x2 box filter, odd edges are clamped
+    // A source with block columns is tiled, levels are linear
+    for(int y = y0; y < y1; y++)
+    {
+        int sy0 = y * 2;
+        int sy1 = mode7_min(sy0 + 1, srcHeight - 1);
+        uint8_t *out = dst->data + y * dst->width;
+        for(int x = x0; x < x1; x++)
+        {
+            int sx0 = x * 2;
+            int sx1 = mode7_min(sx0 + 1, srcWidth - 1);
+            if(srcColumns)
+            {
+                out[x] = (src[blockOffset(sx0, sy0, srcColumns)] + src[blockOffset(sx1, sy0, srcColumns)] + src[blockOffset(sx0, sy1, srcColumns)] + src[blockOffset(sx1, sy1, srcColumns)] + 2) >> 2;
+            }
+            else
+            {
+                out[x] = (src[sy0 * srcWidth + sx0] + src[sy0 * srcWidth + sx1] + src[sy1 * srcWidth + sx0] + src[sy1 * srcWidth + sx1] + 2) >> 2;
+            }
+        }
+    }
+}
+
+static void bitmapUpdateMipmaps(PDMode7_Bitmap *bitmap, PDMode7_Rect rect)
+{
+    int x0 = mode7_max(rect.x, 0);
+    int y0 = mode7_max(rect.y, 0);
+    int x1 = mode7_min(rect.x + rect.width, bitmap->width);
+    int y1 = mode7_min(rect.y + rect.height, bitmap->height);
+    
+    const uint8_t *src = bitmap->data;
+    int srcWidth = bitmap->width;
+    int srcHeight = bitmap->height;
+    int srcColumns = bitmap->blockColumns;
+    
+    for(int i = 0; i < bitmap->mipLevels && x0 < x1 && y0 < y1; i++)
+    {
+        // Texels touched by the rect in the next level
+        x0 >>= 1; y0 >>= 1;
+        x1 = (x1 + 1) >> 1; y1 = (y1 + 1) >> 1;
+        
+        _PDMode7_MipLevel *mip = &bitmap->mips[i];
+        mipDownsample(src, srcWidth, srcHeight, srcColumns, mip, x0, y0, x1, y1);
+        
+        src = mip->data;
+        srcWidth = mip->width;
+        srcHeight = mip->height;
+        srcColumns = 0;
+    }
+}
+
+static void bitmapRemoveMipmaps(PDMode7_Bitmap *bitmap)
+{
+    if(bitmap->freeMipData)
+    {
+        playdate->system->realloc(bitmap->mipData, 0);
+    }
+    bitmap->mipData = NULL;
+    bitmap->mipLevels = 0;
+    bitmap->freeMipData = 0;
+    
+    bitmapDidChange(bitmap, newRect(0, 0, bitmap->width, bitmap->height));
+}
+
+static void bitmapDidChange(PDMode7_Bitmap *bitmap, PDMode7_Rect rect)
+{
+    // Called after the bitmap data is modified in rect
+    bitmapUpdateMipmaps(bitmap, rect);
+    
+    // Changed texels are accumulated until the plane is redrawn
+    int x0 = mode7_max(rect.x, 0);
+    int y0 = mode7_max(rect.y, 0);
+    int x1 = mode7_min(rect.x + rect.width, bitmap->width);
+    int y1 = mode7_min(rect.y + rect.height, bitmap->height);
+    if(x1 > x0 && y1 > y0)
+    {
+        PDMode7_Rect dirtyRect = bitmap->dirtyRect;
+        if(dirtyRect.width > 0 && dirtyRect.height > 0)
+        {
+            x0 = mode7_min(x0, dirtyRect.x);
+            y0 = mode7_min(y0, dirtyRect.y);
+            x1 = mode7_max(x1, dirtyRect.x + dirtyRect.width);
+            y1 = mode7_max(y1, dirtyRect.y + dirtyRect.height);
+        }
+        bitmap->dirtyRect = newRect(x0, y0, x1 - x0, y1 - y0);
+    }
+    
+    bitmap->version++;
+    bitmapVersion++;
+}
+
+static void bitmapClearDirtyRect(PDMode7_Bitmap *bitmap)
+{
+    bitmap->dirtyRect = newRect(0, 0, 0, 0);
+    bitmap->dirtyVersion = bitmap->version;
+}
+
+static void bitmapInvalidate(PDMode7_Bitmap *bitmap)
+{
+    bitmapDidChange(bitmap, newRect(0, 0, bitmap->width, bitmap->height));
+}
+
+static void bitmapGenerateMipmaps(PDMode7_Bitmap *bitmap)
+{
+    if(bitmap->mipLevels == 0)
+    {
+        int levels = 0;
+        size_t size = 0;
+        int width = bitmap->width;
+        int height = bitmap->height;
+        
+        while((width > 1 || height > 1) && levels < MODE7_MIP_MAX_LEVELS)
+        {
+            width = (width + 1) >> 1;
+            height = (height + 1) >> 1;
+            bitmap->mips[levels] = (_PDMode7_MipLevel){
+                .data = NULL,
+                .width = width,
+                .height = height
+            };
+            size += width * height;
+            levels++;
+        }
+        
+        if(levels == 0)
+        {
+            return;
+        }
+        
+        // Levels are stored contiguously, a loaded bitmap keeps them in the pool right after its data
+        uint8_t *data = bitmap->freeData ? NULL : poolAlloc(pool, size);
+        bitmap->freeMipData = 0;
+        if(!data)
+        {
+            data = playdate->system->realloc(NULL, size);
+            bitmap->freeMipData = 1;
+        }
+        
+        bitmap->mipData = data;
+        for(int i = 0; i < levels; i++)
+        {
+            bitmap->mips[i].data = data;
+            data += bitmap->mips[i].width * bitmap->mips[i].height;
+        }
+        bitmap->mipLevels = levels;
+    }
+    
+    bitmapDidChange(bitmap, newRect(0, 0, bitmap->width, bitmap->height));
+}
+
+static void bitmapSetLayout(PDMode7_Bitmap *bitmap, PDMode7_BitmapLayout layout)
+{
+    if(layout == bitmap->layout || (layout != kMode7BitmapLayoutLinear && layout != kMode7BitmapLayoutTiled))
+    {
+        return;
+    }
+    
+    const int log = MODE7_BITMAP_BLOCK_LOG;
+    int width = bitmap->width;
+    int height = bitmap->height;
+    int columns = (width + (1 << log) - 1) >> log;
+    int rows = (height + (1 << log) - 1) >> log;
+    int toTiled = (layout == kMode7BitmapLayoutTiled);
+    
+    if(width == (columns << log) && height == (rows << log))
+    {
+        // No padding, convert in place one band of blocks at a time
+        // A loaded bitmap stays in the pool
+        size_t bandSize = width << log;
+        uint8_t *band = playdate->system->realloc(NULL, bandSize);
+        for(int by = 0; by < rows; by++)
+        {
+            uint8_t *data = bitmap->data + by * bandSize;
+            memcpy(band, data, bandSize);
+            for(int y = 0; y < (1 << log); y++)
+            {
+                for(int x = 0; x < width; x++)
+                {
+                    if(toTiled)
+                    {
+                        data[blockOffset(x, y, columns)] = band[y * width + x];
+                    }
+                    else
+                    {
+                        data[y * width + x] = band[blockOffset(x, y, columns)];
+                    }
+                }
+            }
+        }
+        playdate->system->realloc(band, 0);
+    }
+    else
+    {
+        // Tiled data is padded to whole blocks
+        size_t size = toTiled ? ((size_t)(columns * rows) << (log * 2)) : (size_t)(width * height);
+        uint8_t *data = playdate->system->realloc(NULL, size);
+        memset(data, 0, size);
+        for(int y = 0; y < height; y++)
+        {
+            for(int x = 0; x < width; x++)
+            {
+                int offset = toTiled ? blockOffset(x, y, columns) : (y * width + x);
+                data[offset] = bitmap->data[bitmapOffset(bitmap, x, y)];
+            }
+        }
+        if(bitmap->freeData)
+        {
+            playdate->system->realloc(bitmap->data, 0);
+        }
+        bitmap->data = data;
+        bitmap->freeData = 1;
+    }
+    
+    bitmap->layout = layout;
+    bitmap->blockColumns = toTiled ? columns : 0;
+}
+
+static PDMode7_BitmapLayout bitmapGetLayout(PDMode7_Bitmap *bitmap)
+{
+    return bitmap->layout;
+}
+
 static void releaseBitmap(PDMode7_Bitmap *bitmap)
 {
     if(bitmap->luaRef)
@@ -4267,6 +7405,8 @@ static void freeBitmap(PDMode7_Bitmap *bitmap)
         playdate->system->realloc(bitmap->data, 0);
     }
     
+    bitmapRemoveMipmaps(bitmap);
+    
     playdate->system->realloc(bitmap, 0);
 }
 
@@ -4307,10 +7447,11 @@ static void bitmapLayerRestore(PDMode7_BitmapLayer *layer)
             int src_y = layer->comp.offsetY + y;
             int dst_y = layer->comp.rect.y + y;
             int src_offset = src_y * layer->rect.width + layer->comp.offsetX;
-            int dst_offset = dst_y * parentBitmap->width + layer->comp.rect.x;
-
-            memcpy(parentBitmap->data + dst_offset, layer->comp.data + src_offset, layer->comp.rect.width);
+            
+            bitmapWriteRow(parentBitmap, layer->comp.rect.x, dst_y, layer->comp.rect.width, layer->comp.data + src_offset);
         }
+        
+        bitmapDidChange(parentBitmap, layer->comp.rect);
     }
 }
 
@@ -4338,9 +7479,8 @@ static void bitmapLayerDraw(PDMode7_BitmapLayer *layer)
             int src_y = layer->comp.offsetY + y;
             int dst_y = layer->comp.rect.y + y;
             int src_offset = src_y * layer->rect.width + layer->comp.offsetX;
-            int dst_offset = dst_y * parentBitmap->width + layer->comp.rect.x;
             
-            memcpy(layer->comp.data + src_offset, parentBitmap->data + dst_offset, layer->comp.rect.width);
+            bitmapReadRow(parentBitmap, layer->comp.rect.x, dst_y, layer->comp.rect.width, layer->comp.data + src_offset);
         }
         
         layer->canRestore = 1;
@@ -4349,20 +7489,18 @@ static void bitmapLayerDraw(PDMode7_BitmapLayer *layer)
         {
             int src_y = layer->comp.offsetY + y;
             int dst_y = layer->comp.rect.y + y;
-            int src_rows = src_y * layer->rect.width + layer->comp.offsetX;
-            int dst_rows = dst_y * parentBitmap->width + layer->comp.rect.x;
             
             if(layerBitmap->mask)
             {
                 for(int x = 0; x < layer->comp.rect.width; x++)
                 {
-                    int src_offset = src_rows + x;
-                    int dst_offset = dst_rows + x;
+                    int src_x = layer->comp.offsetX + x;
+                    int dst_offset = bitmapOffset(parentBitmap, layer->comp.rect.x + x, dst_y);
                     
-                    uint8_t color = layerBitmap->data[src_offset];
+                    uint8_t color = layerBitmap->data[bitmapOffset(layerBitmap, src_x, src_y)];
                     uint8_t backgroundColor = parentBitmap->data[dst_offset];
                     
-                    uint8_t alpha = layerBitmap->mask->data[src_offset];
+                    uint8_t alpha = layerBitmap->mask->data[bitmapOffset(layerBitmap->mask, src_x, src_y)];
                     color = backgroundColor + (unsigned int)(alpha * (color - backgroundColor) + 127) / 255;
                     
                     parentBitmap->data[dst_offset] = color;
@@ -4370,9 +7508,11 @@ static void bitmapLayerDraw(PDMode7_BitmapLayer *layer)
             }
             else
             {
-                memcpy(parentBitmap->data + dst_rows, layerBitmap->data + src_rows, layer->comp.rect.width);
+                bitmapCopyRow(layerBitmap, layer->comp.offsetX, src_y, parentBitmap, layer->comp.rect.x, dst_y, layer->comp.rect.width);
             }
         }
+        
+        bitmapDidChange(parentBitmap, layer->comp.rect);
     }
 }
 
@@ -4677,8 +7817,10 @@ static int lua_newWorld(lua_State *L)
     float height = playdate->lua->getArgFloat(2);
     float depth = playdate->lua->getArgFloat(3);
     int gridCellSize = playdate->lua->getArgInt(4);
+    PDMode7_GridType gridType = playdate->lua->getArgInt(5);
+    int grid2D = playdate->lua->getArgBool(6);
     
-    PDMode7_World *world = worldWithParameters(width, height, depth, gridCellSize);
+    PDMode7_World *world = worldWithParameters(width, height, depth, gridCellSize, gridType, grid2D);
     
     PDMode7_Display *mainDisplay = world->mainDisplay;
     
@@ -4841,6 +7983,36 @@ static int lua_getCeilingTilemap(lua_State *L)
     return 1;
 }
 
+static int lua_setPlaneAddressMode(lua_State *L)
+{
+    PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
+    PDMode7_AddressMode addressMode = playdate->lua->getArgInt(2);
+    setPlaneAddressMode(world, addressMode);
+    return 0;
+}
+
+static int lua_getPlaneAddressMode(lua_State *L)
+{
+    PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
+    playdate->lua->pushInt(getPlaneAddressMode(world));
+    return 1;
+}
+
+static int lua_setCeilingAddressMode(lua_State *L)
+{
+    PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
+    PDMode7_AddressMode addressMode = playdate->lua->getArgInt(2);
+    setCeilingAddressMode(world, addressMode);
+    return 0;
+}
+
+static int lua_getCeilingAddressMode(lua_State *L)
+{
+    PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
+    playdate->lua->pushInt(getCeilingAddressMode(world));
+    return 1;
+}
+
 static int lua_worldUpdate(lua_State *L)
 {
     PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
@@ -4856,6 +8028,23 @@ static int lua_worldDraw(lua_State *L)
     return 0;
 }
 
+static int lua_worldDrawAll(lua_State *L)
+{
+    PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
+    worldDrawAll(world);
+    return 0;
+}
+
+static int lua_worldGetQueryStats(lua_State *L)
+{
+    PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
+    int cells; int sprites;
+    worldGetQueryStats(world, &cells, &sprites);
+    playdate->lua->pushInt(cells);
+    playdate->lua->pushInt(sprites);
+    return 2;
+}
+
 static int lua_addSprite(lua_State *L)
 {
     PDMode7_World *world = playdate->lua->getArgObject(1, lua_kWorld, NULL);
@@ -4973,6 +8162,10 @@ static const lua_reg lua_world[] = {
     { "getPlaneTilemap", lua_getPlaneTilemap },
     { "setCeilingTilemap", lua_setCeilingTilemap },
     { "getCeilingTilemap", lua_getCeilingTilemap },
+    { "setPlaneAddressMode", lua_setPlaneAddressMode },
+    { "getPlaneAddressMode", lua_getPlaneAddressMode },
+    { "setCeilingAddressMode", lua_setCeilingAddressMode },
+    { "getCeilingAddressMode", lua_getCeilingAddressMode },
     { "_planeColorAt", lua_planeColorAt },
     { "_ceilingColorAt", lua_ceilingColorAt },
     { "displayToPlanePoint", lua_displayToPlanePoint },
@@ -4982,6 +8175,8 @@ static const lua_reg lua_world[] = {
     { "planeToBitmapPoint", lua_planeToBitmapPoint },
     { "update", lua_worldUpdate },
     { "draw", lua_worldDraw },
+    { "drawAll", lua_worldDrawAll },
+    { "getQueryStats", lua_worldGetQueryStats },
     { "__gc", lua_freeWorld },
     { NULL, NULL }
 };
@@ -5029,6 +8224,25 @@ static int lua_displaySetScale(lua_State *L)
     return 0;
 }
 
+static int lua_displayGetAdaptiveScale(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    float distance2x; float distance4x;
+    displayGetAdaptiveScale(display, &distance2x, &distance4x);
+    playdate->lua->pushFloat(distance2x);
+    playdate->lua->pushFloat(distance4x);
+    return 2;
+}
+
+static int lua_displaySetAdaptiveScale(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    float distance2x = playdate->lua->getArgFloat(2);
+    float distance4x = playdate->lua->getArgFloat(3);
+    displaySetAdaptiveScale(display, distance2x, distance4x);
+    return 0;
+}
+
 static int lua_displayGetDitherType(lua_State *L)
 {
     PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
@@ -5045,6 +8259,72 @@ static int lua_displaySetDitherType(lua_State *L)
     return 0;
 }
 
+static int lua_displayGetRenderMode(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    PDMode7_DisplayRenderMode mode = displayGetRenderMode(display);
+    playdate->lua->pushInt(mode);
+    return 1;
+}
+
+static int lua_displaySetRenderMode(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    PDMode7_DisplayRenderMode mode = playdate->lua->getArgInt(2);
+    displaySetRenderMode(display, mode);
+    return 0;
+}
+
+static int lua_displayGetRowDiffing(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    int flag = displayGetRowDiffing(display);
+    playdate->lua->pushBool(flag);
+    return 1;
+}
+
+static int lua_displaySetRowDiffing(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    int flag = playdate->lua->getArgBool(2);
+    displaySetRowDiffing(display, flag);
+    return 0;
+}
+
+static int lua_displayGetSkippedRows(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    int rows = displayGetSkippedRows(display);
+    playdate->lua->pushInt(rows);
+    return 1;
+}
+
+static int lua_displayGetRefreshThreshold(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    float distance; float angle;
+    displayGetRefreshThreshold(display, &distance, &angle);
+    playdate->lua->pushFloat(distance);
+    playdate->lua->pushFloat(angle);
+    return 2;
+}
+
+static int lua_displaySetRefreshThreshold(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    float distance = playdate->lua->getArgFloat(2);
+    float angle = playdate->lua->getArgFloat(3);
+    displaySetRefreshThreshold(display, distance, angle);
+    return 0;
+}
+
+static int lua_displayInvalidate(lua_State *L)
+{
+    PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
+    displayInvalidate_public(display);
+    return 0;
+}
+
 static int lua_displaySetPlaneShader(lua_State *L)
 {
     PDMode7_Display *display = playdate->lua->getArgObject(1, lua_kDisplay, NULL);
@@ -5206,8 +8486,18 @@ static const lua_reg lua_display[] = {
     { "setCamera", lua_displaySetCamera },
     { "getScale", lua_displayGetScale },
     { "setScale", lua_displaySetScale },
+    { "getAdaptiveScale", lua_displayGetAdaptiveScale },
+    { "setAdaptiveScale", lua_displaySetAdaptiveScale },
     { "getDitherType", lua_displayGetDitherType },
     { "setDitherType", lua_displaySetDitherType },
+    { "getRenderMode", lua_displayGetRenderMode },
+    { "setRenderMode", lua_displaySetRenderMode },
+    { "getRefreshThreshold", lua_displayGetRefreshThreshold },
+    { "setRefreshThreshold", lua_displaySetRefreshThreshold },
+    { "getRowDiffing", lua_displayGetRowDiffing },
+    { "setRowDiffing", lua_displaySetRowDiffing },
+    { "getSkippedRows", lua_displayGetSkippedRows },
+    { "invalidate", lua_displayInvalidate },
     { "getPlaneShader", lua_displayGetPlaneShader },
     { "setPlaneShader", lua_displaySetPlaneShader },
     { "getCeilingShader", lua_displayGetCeilingShader },
@@ -5515,6 +8805,22 @@ static int lua_cameraGetClipDistanceUnits(lua_State *L)
     return 1;
 }
 
+static int lua_cameraGetFarDistance(lua_State *L)
+{
+    PDMode7_Camera *camera = playdate->lua->getArgObject(1, lua_kCamera, NULL);
+    float distance = cameraGetFarDistance(camera);
+    playdate->lua->pushFloat(distance);
+    return 1;
+}
+
+static int lua_cameraSetFarDistance(lua_State *L)
+{
+    PDMode7_Camera *camera = playdate->lua->getArgObject(1, lua_kCamera, NULL);
+    float distance = playdate->lua->getArgFloat(2);
+    cameraSetFarDistance(camera, distance);
+    return 0;
+}
+
 static int lua_cameraSetClipDistanceUnits(lua_State *L)
 {
     PDMode7_Camera *camera = playdate->lua->getArgObject(1, lua_kCamera, NULL);
@@ -5553,6 +8859,8 @@ static const lua_reg lua_camera[] = {
     { "setFOV", lua_cameraSetFOV },
     { "getClipDistanceUnits", lua_cameraGetClipDistanceUnits },
     { "setClipDistanceUnits", lua_cameraSetClipDistanceUnits },
+    { "getFarDistance", lua_cameraGetFarDistance },
+    { "setFarDistance", lua_cameraSetFarDistance },
     { "lookAtPoint", lua_cameraLookAtPoint },
     { "__gc", lua_freeCamera },
     { NULL, NULL }
@@ -6012,6 +9320,7 @@ static int lua_spriteGetInstances(lua_State *L)
     int length;
     PDMode7_SpriteInstance** instances = spriteGetInstances(sprite, &length);
     _PDMode7_Array *array = newArray();
+    arrayReserve(array, length);
     for(int i = 0; i < length; i++)
     {
         arrayPush(array, instances[i]);
@@ -6433,6 +9742,43 @@ static int lua_bitmapRemoveAllLayers(lua_State *L)
     return 0;
 }
 
+static int lua_bitmapGenerateMipmaps(lua_State *L)
+{
+    PDMode7_Bitmap *bitmap = playdate->lua->getArgObject(1, lua_kBitmap, NULL);
+    bitmapGenerateMipmaps(bitmap);
+    return 0;
+}
+
+static int lua_bitmapRemoveMipmaps(lua_State *L)
+{
+    PDMode7_Bitmap *bitmap = playdate->lua->getArgObject(1, lua_kBitmap, NULL);
+    bitmapRemoveMipmaps(bitmap);
+    return 0;
+}
+
+static int lua_bitmapSetLayout(lua_State *L)
+{
+    PDMode7_Bitmap *bitmap = playdate->lua->getArgObject(1, lua_kBitmap, NULL);
+    PDMode7_BitmapLayout layout = playdate->lua->getArgInt(2);
+    bitmapSetLayout(bitmap, layout);
+    return 0;
+}
+
+static int lua_bitmapGetLayout(lua_State *L)
+{
+    PDMode7_Bitmap *bitmap = playdate->lua->getArgObject(1, lua_kBitmap, NULL);
+    PDMode7_BitmapLayout layout = bitmapGetLayout(bitmap);
+    playdate->lua->pushInt(layout);
+    return 1;
+}
+
+static int lua_bitmapInvalidate(lua_State *L)
+{
+    PDMode7_Bitmap *bitmap = playdate->lua->getArgObject(1, lua_kBitmap, NULL);
+    bitmapInvalidate(bitmap);
+    return 0;
+}
+
 static int lua_freeBitmap(lua_State *L)
 {
     PDMode7_Bitmap *bitmap = playdate->lua->getArgObject(1, lua_kBitmap, NULL);
@@ -6452,6 +9798,11 @@ static const lua_reg lua_bitmap[] = {
     { "addLayer", lua_bitmapAddLayer },
     { "getLayers", lua_bitmapGetLayers },
     { "removeAllLayers", lua_bitmapRemoveAllLayers },
+    { "generateMipmaps", lua_bitmapGenerateMipmaps },
+    { "removeMipmaps", lua_bitmapRemoveMipmaps },
+    { "setLayout", lua_bitmapSetLayout },
+    { "getLayout", lua_bitmapGetLayout },
+    { "invalidate", lua_bitmapInvalidate },
     { "__gc", lua_freeBitmap },
     { NULL, NULL }
 };
@@ -6721,6 +10072,8 @@ void PDMode7_init(PlaydateAPI *pd, int enableLua)
     mode7->world->getScale = worldGetScale;
     mode7->world->update = worldUpdate; // LUACHECK
     mode7->world->draw = worldDraw; // LUACHECK
+    mode7->world->drawAll = worldDrawAll; // LUACHECK
+    mode7->world->getQueryStats = worldGetQueryStats; // LUACHECK
     mode7->world->getPlaneBitmap = getPlaneBitmap; // LUACHECK
     mode7->world->setPlaneBitmap = setPlaneBitmap; // LUACHECK
     mode7->world->getPlaneFillColor = getPlaneFillColor; // LUACHECK
@@ -6733,6 +10086,10 @@ void PDMode7_init(PlaydateAPI *pd, int enableLua)
     mode7->world->getPlaneTilemap = getPlaneTilemap; // LUACHECK
     mode7->world->setCeilingTilemap = setCeilingTilemap; // LUACHECK
     mode7->world->getCeilingTilemap = getCeilingTilemap; // LUACHECK
+    mode7->world->setPlaneAddressMode = setPlaneAddressMode; // LUACHECK
+    mode7->world->getPlaneAddressMode = getPlaneAddressMode; // LUACHECK
+    mode7->world->setCeilingAddressMode = setCeilingAddressMode; // LUACHECK
+    mode7->world->getCeilingAddressMode = getCeilingAddressMode; // LUACHECK
     mode7->world->addSprite = addSprite; // LUACHECK
     mode7->world->addDisplay = addDisplay; // LUACHECK
     mode7->world->getSprites = getSprites; // LUACHECK
@@ -6757,8 +10114,18 @@ void PDMode7_init(PlaydateAPI *pd, int enableLua)
     mode7->display->setCamera = displaySetCamera; // LUACHECK
     mode7->display->getScale = displayGetScale; // LUACHECK
     mode7->display->setScale = displaySetScale; // LUACHECK
+    mode7->display->getAdaptiveScale = displayGetAdaptiveScale; // LUACHECK
+    mode7->display->setAdaptiveScale = displaySetAdaptiveScale; // LUACHECK
     mode7->display->getDitherType = displayGetDitherType; // LUACHECK
     mode7->display->setDitherType = displaySetDitherType; // LUACHECK
+    mode7->display->getRenderMode = displayGetRenderMode; // LUACHECK
+    mode7->display->setRenderMode = displaySetRenderMode; // LUACHECK
+    mode7->display->getRefreshThreshold = displayGetRefreshThreshold; // LUACHECK
+    mode7->display->setRefreshThreshold = displaySetRefreshThreshold; // LUACHECK
+    mode7->display->getRowDiffing = displayGetRowDiffing; // LUACHECK
+    mode7->display->setRowDiffing = displaySetRowDiffing; // LUACHECK
+    mode7->display->getSkippedRows = displayGetSkippedRows; // LUACHECK
+    mode7->display->invalidate = displayInvalidate_public; // LUACHECK
     mode7->display->getPlaneShader = displayGetPlaneShader; // LUACHECK
     mode7->display->setPlaneShader = displaySetPlaneShader; // LUACHECK
     mode7->display->getCeilingShader = displayGetCeilingShader; // LUACHECK
@@ -6793,6 +10160,8 @@ void PDMode7_init(PlaydateAPI *pd, int enableLua)
     mode7->camera->setPitch = cameraSetPitch; // LUACHECK
     mode7->camera->getClipDistanceUnits = cameraGetClipDistanceUnits; // LUACHECK
     mode7->camera->setClipDistanceUnits = cameraSetClipDistanceUnits; // LUACHECK
+    mode7->camera->getFarDistance = cameraGetFarDistance; // LUACHECK
+    mode7->camera->setFarDistance = cameraSetFarDistance; // LUACHECK
     mode7->camera->lookAtPoint = cameraLookAtPoint; // LUACHECK
     mode7->camera->freeCamera = freeCamera; // LUACHECK
 
@@ -6878,6 +10247,11 @@ void PDMode7_init(PlaydateAPI *pd, int enableLua)
     mode7->bitmap->addLayer = bitmapAddLayer; // LUACHECK
     mode7->bitmap->getLayers = bitmapGetLayers; // LUACHECK
     mode7->bitmap->removeAllLayers = bitmapRemoveAllLayers; // LUACHECK
+    mode7->bitmap->generateMipmaps = bitmapGenerateMipmaps; // LUACHECK
+    mode7->bitmap->removeMipmaps = bitmapRemoveMipmaps; // LUACHECK
+    mode7->bitmap->setLayout = bitmapSetLayout; // LUACHECK
+    mode7->bitmap->getLayout = bitmapGetLayout; // LUACHECK
+    mode7->bitmap->invalidate = bitmapInvalidate; // LUACHECK
     mode7->bitmap->freeBitmap = freeBitmap; // LUACHECK
     
     mode7->bitmap->layer = playdate->system->realloc(NULL, sizeof(PDMode7_BitmapLayer_API));
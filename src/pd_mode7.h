@@ -23,6 +23,10 @@
 #define PD_MODE7_TILEMAP 0
 #endif
 
+#ifndef PD_MODE7_FIXED_POINT
+#define PD_MODE7_FIXED_POINT 0
+#endif
+
 typedef struct PDMode7_Vec2 {
     float x, y;
 } PDMode7_Vec2;
@@ -67,6 +71,23 @@ typedef enum {
     kMode7DisplayFlipModeXY
 } PDMode7_DisplayFlipMode;
 
+typedef enum {
+    kMode7DisplayRenderModeFull,
+    kMode7DisplayRenderModeInterlaced,
+    kMode7DisplayRenderModeCheckerboard
+} PDMode7_DisplayRenderMode;
+
+typedef enum {
+    kMode7AddressModeFill,
+    kMode7AddressModeRepeat,
+    kMode7AddressModeMirroredRepeat
+} PDMode7_AddressMode;
+
+typedef enum {
+    kMode7BitmapLayoutLinear,
+    kMode7BitmapLayoutTiled
+} PDMode7_BitmapLayout;
+
 typedef enum {
     kMode7DitherBayer2x2 = 0,
     kMode7DitherBayer4x4 = 1,
@@ -96,11 +117,18 @@ typedef enum {
     kMode7SpriteVisibilityModeShader
 } PDMode7_SpriteVisibilityMode;
 
+typedef enum {
+    kMode7GridTypeDense,
+    kMode7GridTypeSparse
+} PDMode7_GridType;
+
 typedef struct PDMode7_WorldConfiguration {
     float width;
     float height;
     float depth;
     int gridCellSize;
+    PDMode7_GridType gridType;
+    int grid2D;
 } PDMode7_WorldConfiguration;
 
 typedef struct PDMode7_World PDMode7_World;
@@ -145,6 +173,10 @@ typedef struct PDMode7_World_API {
     PDMode7_Tilemap*(*getPlaneTilemap)(PDMode7_World *world);
     void(*setCeilingTilemap)(PDMode7_World *world, PDMode7_Tilemap *tilemap);
     PDMode7_Tilemap*(*getCeilingTilemap)(PDMode7_World *world);
+    void(*setPlaneAddressMode)(PDMode7_World *world, PDMode7_AddressMode addressMode);
+    PDMode7_AddressMode(*getPlaneAddressMode)(PDMode7_World *world);
+    void(*setCeilingAddressMode)(PDMode7_World *world, PDMode7_AddressMode addressMode);
+    PDMode7_AddressMode(*getCeilingAddressMode)(PDMode7_World *world);
     PDMode7_Tilemap*(*newTilemap)(PDMode7_World *world, int tileWidth, int tileHeight);
     PDMode7_Vec3(*worldToDisplayPoint)(PDMode7_World *world, PDMode7_Vec3 point, PDMode7_Display *display);
     PDMode7_Vec3(*displayToPlanePoint)(PDMode7_World *world, int displayX, int displayY, PDMode7_Display *display);
@@ -157,6 +189,8 @@ typedef struct PDMode7_World_API {
     int(*addDisplay)(PDMode7_World *world, PDMode7_Display *display);
     void(*update)(PDMode7_World *world);
     void(*draw)(PDMode7_World *world, PDMode7_Display *display);
+    void(*drawAll)(PDMode7_World *world);
+    void(*getQueryStats)(PDMode7_World *world, int *cells, int *sprites);
     void(*freeWorld)(PDMode7_World *world);
 } PDMode7_World_API;
 
@@ -172,6 +206,8 @@ typedef struct PDMode7_Camera_API {
     void(*setFOV)(PDMode7_Camera *camera, float fov);
     int(*getClipDistanceUnits)(PDMode7_Camera *camera);
     void(*setClipDistanceUnits)(PDMode7_Camera *camera, int units);
+    float(*getFarDistance)(PDMode7_Camera *camera);
+    void(*setFarDistance)(PDMode7_Camera *camera, float distance);
     void(*lookAtPoint)(PDMode7_Camera *camera, PDMode7_Vec3 point);
     void(*freeCamera)(PDMode7_Camera *camera);
 } PDMode7_Camera_API;
@@ -199,8 +235,18 @@ typedef struct PDMode7_Display_API {
     PDMode7_Background*(*getBackground)(PDMode7_Display *display);
     PDMode7_DisplayScale(*getScale)(PDMode7_Display *display);
     void(*setScale)(PDMode7_Display *display, PDMode7_DisplayScale scale);
+    void(*getAdaptiveScale)(PDMode7_Display *display, float *distance2x, float *distance4x);
+    void(*setAdaptiveScale)(PDMode7_Display *display, float distance2x, float distance4x);
     PDMode7_DitherType(*getDitherType)(PDMode7_Display *display);
     void(*setDitherType)(PDMode7_Display *display, PDMode7_DitherType type);
+    PDMode7_DisplayRenderMode(*getRenderMode)(PDMode7_Display *display);
+    void(*setRenderMode)(PDMode7_Display *display, PDMode7_DisplayRenderMode mode);
+    void(*getRefreshThreshold)(PDMode7_Display *display, float *distance, float *angle);
+    void(*setRefreshThreshold)(PDMode7_Display *display, float distance, float angle);
+    int(*getRowDiffing)(PDMode7_Display *display);
+    void(*setRowDiffing)(PDMode7_Display *display, int flag);
+    int(*getSkippedRows)(PDMode7_Display *display);
+    void(*invalidate)(PDMode7_Display *display);
     void(*setPlaneShader)(PDMode7_Display *display, PDMode7_Shader *shader);
     PDMode7_Shader*(*getPlaneShader)(PDMode7_Display *display);
     void(*setCeilingShader)(PDMode7_Display *display, PDMode7_Shader *shader);
@@ -374,6 +420,11 @@ typedef struct PDMode7_Bitmap_API {
     void(*addLayer)(PDMode7_Bitmap *bitmap, PDMode7_BitmapLayer *layer);
     PDMode7_BitmapLayer**(*getLayers)(PDMode7_Bitmap *bitmap, int *length);
     void(*removeAllLayers)(PDMode7_Bitmap *bitmap);
+    void(*generateMipmaps)(PDMode7_Bitmap *bitmap);
+    void(*removeMipmaps)(PDMode7_Bitmap *bitmap);
+    void(*setLayout)(PDMode7_Bitmap *bitmap, PDMode7_BitmapLayout layout);
+    PDMode7_BitmapLayout(*getLayout)(PDMode7_Bitmap *bitmap);
+    void(*invalidate)(PDMode7_Bitmap *bitmap);
     void(*freeBitmap)(PDMode7_Bitmap *bitmap);
     PDMode7_BitmapLayer_API *layer;
 } PDMode7_Bitmap_API;